@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace bench
+{
+	using clock = std::chrono::steady_clock;
+
+	// best of reps runs of f in seconds, the minimum is the least disturbed by the rest of the machine
+	template <typename F>
+	double best_of(int reps, F&& f)
+	{
+		double best = 1e30;
+		for (int r = 0; r < reps; r++)
+		{
+			auto start = clock::now();
+			f();
+			double seconds = std::chrono::duration<double>(clock::now() - start).count();
+			if (seconds < best)
+				best = seconds;
+		}
+		return best;
+	}
+
+	// repetition count from the BENCH_REPS environment variable
+	inline int reps(int fallback)
+	{
+		const char* value = std::getenv("BENCH_REPS");
+		return value && std::atoi(value) > 0 ? std::atoi(value) : fallback;
+	}
+
+	inline std::string file_name(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? path : path.substr(slash + 1);
+	}
+
+	// keeps results alive so the measured work is not optimised away
+	inline volatile uint64_t sink = 0;
+}
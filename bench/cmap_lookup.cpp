@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "bench.hpp"
+#include "font_face.hpp"
+
+// cost of mapping every BMP codepoint one at a time, in ascending and in shuffled order, and as a single batch,
+// for the plain cmap search and for dense_cmap
+
+static void measure(const char* path, bool dense, int reps)
+{
+	tou::font_load_options options;
+	options.dense_cmap = dense;
+	tou::font_face face(path, options);
+	if (!face)
+	{
+		std::printf("%-28s failed to load\n", bench::file_name(path).c_str());
+		return;
+	}
+
+	std::vector<char32_t> ascending(0x10000);
+	std::iota(ascending.begin(), ascending.end(), 0);
+	std::vector<char32_t> shuffled = ascending;
+	std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(1));
+	std::vector<uint16_t> glyph_ids(ascending.size());
+
+	// one warm-up pass, lazy structures (dense table, Latin-1 table) are built on first use
+	face.map_codepoints(ascending.data(), ascending.size(), glyph_ids.data());
+	uint64_t mapped = std::count_if(glyph_ids.begin(), glyph_ids.end(), [](uint16_t id) { return id != 0; });
+
+	double per_lookup[3];
+	for (int order = 0; order < 2; order++)
+	{
+		const std::vector<char32_t>& codepoints = order == 0 ? ascending : shuffled;
+		double seconds = bench::best_of(reps, [&]
+		{
+			uint64_t sum = 0;
+			for (char32_t codepoint : codepoints)
+			{
+				uint16_t id;
+				face.map_codepoints(&codepoint, 1, &id);
+				sum += id;
+			}
+			bench::sink = sum;
+		});
+		per_lookup[order] = seconds * 1e9 / codepoints.size();
+	}
+	double seconds = bench::best_of(reps, [&] { face.map_codepoints(ascending.data(), ascending.size(), glyph_ids.data()); });
+	per_lookup[2] = seconds * 1e9 / ascending.size();
+
+	std::printf("%-28s %-6s %7llu %12.1f %12.1f %12.1f\n", bench::file_name(path).c_str(), dense ? "dense" : "search",
+		static_cast<unsigned long long>(mapped), per_lookup[0], per_lookup[1], per_lookup[2]);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: %s font.ttf [font.ttf ...]\n", argv[0]);
+		return 1;
+	}
+
+	std::printf("%-28s %-6s %7s %12s %12s %12s\n", "font (ns per codepoint)", "cmap", "mapped", "ascending", "shuffled", "batch");
+	int reps = bench::reps(5);
+	for (int i = 1; i < argc; i++)
+		for (bool dense : { false, true })
+			measure(argv[i], dense, reps);
+	return 0;
+}
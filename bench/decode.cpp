@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "bench.hpp"
+#include "font_face.hpp"
+#include "util.hpp"
+
+// outline decoding throughput: every glyph of the font is decoded into a fresh face's cache on one thread
+// composites are included, their components are decoded once and then reused from the cache
+
+// numGlyphs from maxp, the face doesn't expose it
+static uint16_t count_glyphs(const char* path)
+{
+	tou::vector_reader reader;
+	if (!reader.load(path) || reader.size() < 12)
+		return 0;
+	const char* header = reader.get_bytes(4, 2);
+	uint16_t num_tables = tou::join_bytes(header[0], header[1]);
+	for (uint16_t i = 0; i < num_tables; i++)
+	{
+		const char* record = reader.get_bytes(12 + i * 16, 16);
+		if (!record || std::string(record, 4) != "maxp")
+			continue;
+		uint32_t offset = tou::join_bytes({ record[8], record[9], record[10], record[11] });
+		const char* num_glyphs = reader.get_bytes(offset + 4, 2);
+		return num_glyphs ? tou::join_bytes(num_glyphs[0], num_glyphs[1]) : 0;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: %s font.ttf [font.ttf ...]\n", argv[0]);
+		return 1;
+	}
+
+	std::printf("%-28s %7s %10s %14s\n", "font", "glyphs", "best ms", "glyphs/s");
+	int reps = bench::reps(10);
+	for (int i = 1; i < argc; i++)
+	{
+		uint16_t num_glyphs = count_glyphs(argv[i]);
+		tou::font_face loaded(argv[i]);
+		if (!loaded || num_glyphs == 0)
+		{
+			std::printf("%-28s failed to load\n", bench::file_name(argv[i]).c_str());
+			continue;
+		}
+
+		// copies share the parsed font but start with an empty glyph cache, so only the decoding is timed
+		double seconds = 1e30;
+		for (int r = 0; r < reps; r++)
+		{
+			tou::font_face face(loaded);
+			seconds = std::min(seconds, bench::best_of(1, [&] { face.preload(1); }));
+		}
+		std::printf("%-28s %7u %10.2f %14.0f\n", bench::file_name(argv[i]).c_str(), num_glyphs, seconds * 1e3, num_glyphs / seconds);
+	}
+	return 0;
+}
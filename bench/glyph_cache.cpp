@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "font_face.hpp"
+
+// 1 to 64 threads calling get_glyph on the same small set of hot glyphs of one face, the total number of lookups is split
+// between the threads, reported as ns per lookup for the face without a cache limit, with a limit the hot set fits in
+// and with one half its size, where lookups keep evicting each other
+// usage: bench_glyph_cache font.ttf [hot characters], BENCH_LOOKUPS sets the total number of lookups
+
+static double ns_per_lookup(tou::font_face& face, const std::vector<uint32_t>& hot, unsigned threads, long lookups, int reps)
+{
+	double seconds = bench::best_of(reps, [&]
+	{
+		std::atomic<bool> start{ false };
+		std::atomic<uint64_t> sum{ 0 };
+		std::vector<std::thread> workers;
+		for (unsigned t = 0; t < threads; t++)
+		{
+			workers.emplace_back([&, t]
+			{
+				while (!start.load())
+					std::this_thread::yield();
+				uint64_t points = 0;
+				size_t next = t % hot.size();
+				for (long i = 0; i < lookups / threads; i++)
+				{
+					points += face.get_glyph(hot[next]).num_points;
+					if (++next == hot.size())
+						next = 0;
+				}
+				sum += points;
+			});
+		}
+		start = true;
+		for (std::thread& worker : workers)
+			worker.join();
+		bench::sink = sum.load();
+	});
+	return seconds * 1e9 / lookups;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: %s font.ttf [hot characters]\n", argv[0]);
+		return 1;
+	}
+	const char* characters = argc > 2 ? argv[2] : "etaoinshrdlucmfwypvbgkjqxzETAOINSHRDLU0123456789.,";
+	long lookups = std::getenv("BENCH_LOOKUPS") ? std::atol(std::getenv("BENCH_LOOKUPS")) : 4000000;
+
+	tou::font_face loaded(argv[1]);
+	if (!loaded)
+		return 1;
+	std::vector<uint32_t> hot;
+	for (const char* c = characters; *c; c++)
+		hot.push_back(static_cast<unsigned char>(*c));
+
+	// each configuration gets its own copy of the face and a warm cache
+	const size_t limits[] = { 0, hot.size() * 2, std::max<size_t>(hot.size() / 2, 1) };
+	std::vector<tou::font_face> faces;
+	for (size_t limit : limits)
+	{
+		faces.emplace_back(loaded);
+		faces.back().set_glyph_cache_limit(limit);
+		for (uint32_t codepoint : hot)
+			faces.back().get_glyph(codepoint);
+	}
+
+	std::printf("%s, %zu hot glyphs, %u hardware threads, ns per lookup\n", bench::file_name(argv[1]).c_str(), hot.size(), std::thread::hardware_concurrency());
+	std::string fitting = "limit " + std::to_string(limits[1]), evicting = "limit " + std::to_string(limits[2]);
+	std::printf("%8s %12s %12s %12s\n", "threads", "no limit", fitting.c_str(), evicting.c_str());
+	int reps = bench::reps(3);
+	for (unsigned threads = 1; threads <= 64; threads *= 2)
+	{
+		std::printf("%8u", threads);
+		for (tou::font_face& face : faces)
+			std::printf(" %12.1f", ns_per_lookup(face, hot, threads, lookups, reps));
+		std::printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "font_face.hpp"
+
+// preload on 1, 2, 4, ... threads against decoding the same glyphs lazily through get_glyph, each run on a fresh copy
+// of the face, then checks that the outlines preload cached are the ones get_glyph decodes
+// preload decodes every glyph of the font, get_glyph only the ones the codepoint range maps to
+// usage: bench_preload font.ttf [first codepoint] [last codepoint] [max threads], BENCH_PARTIAL=bytes loads in partial mode
+
+static uint64_t digest(const tou::font_face::truetype_glyph& glyph)
+{
+	uint64_t hash = 1469598103934665603ull;
+	auto mix = [&](uint64_t value) { hash = (hash ^ value) * 1099511628211ull; };
+	mix(glyph.id);
+	mix(glyph.advance_width);
+	mix(static_cast<uint16_t>(glyph.left_side_bearing));
+	for (size_t i = 0; i < glyph.outline.num_points(); i++)
+	{
+		mix(static_cast<uint16_t>(glyph.outline.x()[i]));
+		mix(static_cast<uint16_t>(glyph.outline.y()[i]));
+		mix(glyph.outline.flags()[i]);
+	}
+	for (size_t i = 0; i < glyph.outline.num_contours(); i++)
+		mix(glyph.outline.end_points()[i]);
+	return hash;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: %s font.ttf [first codepoint] [last codepoint] [max threads]\n", argv[0]);
+		return 1;
+	}
+	uint32_t first = argc > 2 ? std::strtoul(argv[2], nullptr, 0) : 0x20;
+	uint32_t last = argc > 3 ? std::strtoul(argv[3], nullptr, 0) : 0xFFFF;
+	unsigned max_threads = argc > 4 ? std::strtoul(argv[4], nullptr, 0) : std::max(16u, std::thread::hardware_concurrency());
+
+	tou::font_load_options options;
+	if (const char* partial = std::getenv("BENCH_PARTIAL"))
+	{
+		options.partial = true;
+		options.page_cache_bytes = std::strtoull(partial, nullptr, 0);
+	}
+	tou::font_face loaded(argv[1], options);
+	if (!loaded)
+		return 1;
+
+	std::vector<uint32_t> codepoints;
+	for (uint32_t codepoint = first; codepoint <= last; codepoint++)
+		if (loaded.has_glyph(codepoint))
+			codepoints.push_back(codepoint);
+
+	int reps = bench::reps(3);
+	uint64_t reference = 0;
+	double lazy = 1e30;
+	for (int r = 0; r < reps; r++)
+	{
+		tou::font_face face(loaded);
+		lazy = std::min(lazy, bench::best_of(1, [&]
+		{
+			reference = 0;
+			for (uint32_t codepoint : codepoints)
+				reference += digest(face.get_glyph(codepoint));
+		}));
+	}
+	std::printf("%s, %zu codepoints, %u hardware threads\n", bench::file_name(argv[1]).c_str(), codepoints.size(), std::thread::hardware_concurrency());
+	std::printf("lazy get_glyph        %9.2f ms\n", lazy * 1e3);
+
+	for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+	{
+		double seconds = 1e30;
+		uint64_t sum = 0;
+		for (int r = 0; r < reps; r++)
+		{
+			tou::font_face face(loaded);
+			seconds = std::min(seconds, bench::best_of(1, [&] { face.preload(threads); }));
+			sum = 0;
+			for (uint32_t codepoint : codepoints)
+				sum += digest(face.get_glyph(codepoint));
+		}
+		std::printf("preload %3u threads   %9.2f ms  %5.2fx  %s\n", threads, seconds * 1e3, lazy / seconds, sum == reference ? "same outlines" : "DIFFERENT OUTLINES");
+	}
+	return 0;
+}
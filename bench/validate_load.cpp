@@ -0,0 +1,64 @@
+#include <cstdio>
+#include <vector>
+
+#include "bench.hpp"
+#include "font_face.hpp"
+#include "util.hpp"
+
+// load time of every font given on the command line in eager, lazy and partial mode, each with and without validate,
+// preceded by the throughput of the checksum kernel against a scalar loop over the same buffer
+
+static uint32_t scalar_sum32(const char* src, size_t n)
+{
+	uint32_t sum = 0;
+	for (size_t i = 0; i < n; i++)
+		sum += tou::join_bytes({ src[i * 4], src[i * 4 + 1], src[i * 4 + 2], src[i * 4 + 3] });
+	return sum;
+}
+
+static double load_us(const char* path, bool lazy, bool partial, bool validate, int reps)
+{
+	tou::font_load_options options;
+	options.lazy_tables = lazy;
+	options.partial = partial;
+	options.validate = validate;
+	bool loaded = true;
+	double seconds = bench::best_of(reps, [&]
+	{
+		tou::font_face face;
+		loaded = face.load(path, options) && loaded;
+	});
+	return loaded ? seconds * 1e6 : -1.0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: %s font.ttf [font.ttf ...]\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<char> buffer(16 << 20);
+	for (size_t i = 0; i < buffer.size(); i++)
+		buffer[i] = static_cast<char>(i * 131);
+	size_t words = buffer.size() / 4;
+
+	double scalar = bench::best_of(bench::reps(10), [&] { bench::sink = scalar_sum32(buffer.data(), words); });
+	double kernel = bench::best_of(bench::reps(10), [&] { bench::sink = tou::big_endian_sum32(buffer.data(), words); });
+	bool same = scalar_sum32(buffer.data(), words) == tou::big_endian_sum32(buffer.data(), words);
+	std::printf("checksum scalar loop %6.2f GB/s\n", buffer.size() / scalar / 1e9);
+	std::printf("checksum kernel      %6.2f GB/s%s\n\n", buffer.size() / kernel / 1e9, same ? "" : "  MISMATCH");
+
+	std::printf("%-28s %11s %11s %11s %11s %11s %11s\n", "font (best load, us)", "eager", "eager+v", "lazy", "lazy+v", "partial", "partial+v");
+	int reps = bench::reps(30);
+	for (int i = 1; i < argc; i++)
+	{
+		std::printf("%-28s", bench::file_name(argv[i]).c_str());
+		for (int mode = 0; mode < 3; mode++)
+			for (bool validate : { false, true })
+				std::printf(" %11.1f", load_us(argv[i], mode > 0, mode == 2, validate, reps));
+		std::printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,718 @@
+#include "cff.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace tou
+{
+	namespace cff
+	{
+		namespace
+		{
+			constexpr int MAX_STACK = 48;			// argument stack limit of the Type 2 charstring format
+			constexpr int MAX_SUBR_DEPTH = 10;		// subroutine nesting limit of the Type 2 charstring format
+			constexpr int NUM_TRANSIENTS = 32;
+
+			uint32_t read_offset(const char* b, uint8_t off_size)
+			{
+				uint32_t x = 0;
+				for (uint8_t i = 0; i < off_size; i++)
+					x = (x << 8) | static_cast<uint8_t>(b[i]);
+				return x;
+			}
+
+			// reads the INDEX at 'position' and returns the position just past it, 0 if it doesn't fit before 'end'
+			uint64_t read_index(tou::vector_reader& reader, uint64_t position, uint64_t end, index& out)
+			{
+				out.offsets.clear();
+				if (position + 2 > end)
+					return 0;
+
+				reader.set_position(position);
+				uint16_t count = reader.get_uint16();
+				if (count == 0)
+					return position + 2;
+
+				uint8_t off_size = reader.get_uint8();
+				if (off_size < 1 || off_size > 4)
+					return 0;
+
+				uint64_t offsets_size = static_cast<uint64_t>(count + 1) * off_size;
+				if (position + 3 + offsets_size > end)
+					return 0;
+
+				// offsets are 1-based from the byte preceding the object data
+				uint64_t data_base = position + 2 + offsets_size;
+				const char* b = reader.get_bytes(position + 3, offsets_size);
+				out.offsets.resize(count + 1);
+				uint32_t previous = 1;
+				for (uint32_t i = 0; i <= count; i++)
+				{
+					uint32_t offset = read_offset(b + i * off_size, off_size);
+					if (offset < previous || data_base + offset > end)
+					{
+						out.offsets.clear();
+						return 0;
+					}
+					out.offsets[i] = static_cast<uint32_t>(data_base + offset);
+					previous = offset;
+				}
+
+				return out.offsets.back();
+			}
+
+			// the operators of a DICT with their integer operands, real operands are kept as 0 since none of the keys used here take one
+			struct dict
+			{
+				std::vector<std::pair<uint16_t, std::vector<int32_t>>> entries;
+
+				const std::vector<int32_t>* find(uint16_t op) const
+				{
+					for (const auto& e : entries)
+						if (e.first == op)
+							return &e.second;
+					return nullptr;
+				}
+			};
+
+			constexpr uint16_t escaped(uint8_t op) { return static_cast<uint16_t>(0x0c00 | op); }
+
+			constexpr uint16_t DICT_CHARSTRINGS = 17;
+			constexpr uint16_t DICT_PRIVATE = 18;
+			constexpr uint16_t DICT_SUBRS = 19;
+			constexpr uint16_t DICT_CHARSTRING_TYPE = escaped(6);
+			constexpr uint16_t DICT_ROS = escaped(30);
+			constexpr uint16_t DICT_FDARRAY = escaped(36);
+			constexpr uint16_t DICT_FDSELECT = escaped(37);
+
+			bool parse_dict(tou::vector_reader& reader, uint64_t begin, uint64_t end, dict& out)
+			{
+				out.entries.clear();
+				const char* b = reader.get_bytes(begin, end - begin);
+				size_t n = end - begin;
+				if (!b)
+					return false;
+				std::vector<int32_t> operands;
+
+				for (size_t i = 0; i < n;)
+				{
+					uint8_t b0 = static_cast<uint8_t>(b[i]);
+					if (b0 <= 21)
+					{
+						uint16_t op = b0;
+						if (b0 == 12)
+						{
+							if (i + 1 >= n)
+								return false;
+							op = escaped(static_cast<uint8_t>(b[i + 1]));
+							i++;
+						}
+						i++;
+						out.entries.emplace_back(op, std::move(operands));
+						operands.clear();
+					}
+					else if (b0 == 28)
+					{
+						if (i + 3 > n)
+							return false;
+						operands.push_back(static_cast<int16_t>((static_cast<uint8_t>(b[i + 1]) << 8) | static_cast<uint8_t>(b[i + 2])));
+						i += 3;
+					}
+					else if (b0 == 29)
+					{
+						if (i + 5 > n)
+							return false;
+						operands.push_back(static_cast<int32_t>(read_offset(b + i + 1, 4)));
+						i += 5;
+					}
+					else if (b0 == 30)
+					{
+						// real number, nibbles up to and including a 0xf terminator
+						i++;
+						while (i < n && (static_cast<uint8_t>(b[i]) & 0x0f) != 0x0f && (static_cast<uint8_t>(b[i]) & 0xf0) != 0xf0)
+							i++;
+						if (i >= n)
+							return false;
+						i++;
+						operands.push_back(0);
+					}
+					else if (b0 >= 32 && b0 <= 246)
+					{
+						operands.push_back(static_cast<int32_t>(b0) - 139);
+						i++;
+					}
+					else if (b0 >= 247 && b0 <= 254)
+					{
+						if (i + 2 > n)
+							return false;
+						int32_t b1 = static_cast<uint8_t>(b[i + 1]);
+						operands.push_back(b0 <= 250 ? (b0 - 247) * 256 + b1 + 108 : -(b0 - 251) * 256 - b1 - 108);
+						i += 2;
+					}
+					else
+						return false;
+
+					if (operands.size() > MAX_STACK)
+						return false;
+				}
+				return true;
+			}
+
+			// parses the Private DICT referenced by a Top or Font DICT and returns its local subroutines
+			bool read_private_subrs(tou::vector_reader& reader, const dict& d, uint64_t table_start, uint64_t table_end, index& out)
+			{
+				out.offsets.clear();
+				const std::vector<int32_t>* priv = d.find(DICT_PRIVATE);
+				if (!priv)
+					return true;
+				if (priv->size() != 2 || (*priv)[0] < 0 || (*priv)[1] < 0)
+					return false;
+
+				uint64_t private_start = table_start + static_cast<uint32_t>((*priv)[1]);
+				uint64_t private_end = private_start + static_cast<uint32_t>((*priv)[0]);
+				if (private_end > table_end)
+					return false;
+
+				dict private_dict;
+				if (!parse_dict(reader, private_start, private_end, private_dict))
+					return false;
+
+				// the Subrs offset is relative to the start of the Private DICT
+				const std::vector<int32_t>* subrs = private_dict.find(DICT_SUBRS);
+				if (!subrs)
+					return true;
+				if (subrs->size() != 1 || (*subrs)[0] < 0)
+					return false;
+				return read_index(reader, private_start + static_cast<uint32_t>((*subrs)[0]), table_end, out) != 0;
+			}
+
+			bool read_fd_select(tou::vector_reader& reader, uint64_t position, uint64_t end, uint16_t num_glyphs, size_t num_fds, std::vector<uint8_t>& out)
+			{
+				if (position + 1 > end)
+					return false;
+				reader.set_position(position);
+				uint8_t format = reader.get_uint8();
+				out.assign(num_glyphs, 0);
+
+				if (format == 0)
+				{
+					if (position + 1 + num_glyphs > end)
+						return false;
+					const char* b = reader.get_bytes(position + 1, num_glyphs);
+					for (uint16_t i = 0; i < num_glyphs; i++)
+						out[i] = static_cast<uint8_t>(b[i]);
+				}
+				else if (format == 3)
+				{
+					if (position + 3 > end)
+						return false;
+					uint16_t num_ranges = reader.get_uint16();
+					if (num_ranges == 0 || position + 3 + num_ranges * 3ull + 2 > end)
+						return false;
+
+					uint16_t first = reader.get_uint16();
+					for (uint16_t r = 0; r < num_ranges; r++)
+					{
+						uint8_t fd = reader.get_uint8();
+						uint16_t next = reader.get_uint16(); // the first glyph of the next range, or the sentinel
+						if (next < first)
+							return false;
+						for (uint32_t g = first; g < next && g < num_glyphs; g++)
+							out[g] = fd;
+						first = next;
+					}
+				}
+				else
+					return false;
+
+				for (uint8_t fd : out)
+					if (fd >= num_fds)
+						return false;
+				return true;
+			}
+
+			int32_t subr_bias(uint32_t count)
+			{
+				if (count < 1240)
+					return 107;
+				if (count < 33900)
+					return 1131;
+				return 32768;
+			}
+
+			class interpreter
+			{
+			public:
+				interpreter(const tou::vector_reader& reader, const font& f, const index& local_subrs, path& out)
+					: m_reader(reader), m_font(f), m_local_subrs(local_subrs), m_out(out),
+					m_global_bias(subr_bias(f.global_subrs.count())), m_local_bias(subr_bias(local_subrs.count()))
+				{
+				}
+
+				bool run(uint32_t begin, uint32_t end) { return m_run(begin, end, 0) && m_ended; }
+
+			private:
+				bool m_run(uint32_t begin, uint32_t end, int depth);
+				bool m_call(const index& subrs, int32_t bias, int depth);
+				bool m_escape(uint8_t op);
+
+				// the first stack-clearing operator may be preceded by the advance width, which hmtx already provides
+				void m_skip_width(bool has_width)
+				{
+					if (!m_width_checked && has_width)
+						m_bottom = 1;
+					m_width_checked = true;
+				}
+
+				void m_move(float dx, float dy)
+				{
+					m_x += dx;
+					m_y += dy;
+					m_out.ops.push_back(path_op::move_to);
+					m_out.points.push_back({ m_x, m_y });
+					m_open = true;
+				}
+
+				void m_line(float dx, float dy)
+				{
+					if (!m_open)
+						m_move(0.0f, 0.0f);
+					m_x += dx;
+					m_y += dy;
+					m_out.ops.push_back(path_op::line_to);
+					m_out.points.push_back({ m_x, m_y });
+				}
+
+				void m_curve(float dx1, float dy1, float dx2, float dy2, float dx3, float dy3)
+				{
+					if (!m_open)
+						m_move(0.0f, 0.0f);
+					float x1 = m_x + dx1, y1 = m_y + dy1;
+					float x2 = x1 + dx2, y2 = y1 + dy2;
+					m_x = x2 + dx3;
+					m_y = y2 + dy3;
+					m_out.ops.push_back(path_op::cubic_to);
+					m_out.points.push_back({ x1, y1 });
+					m_out.points.push_back({ x2, y2 });
+					m_out.points.push_back({ m_x, m_y });
+				}
+
+				void m_clear() { m_sp = 0; m_bottom = 0; }
+				int m_args() const { return m_sp - m_bottom; }
+				float m_arg(int i) const { return m_stack[m_bottom + i]; }
+
+			private:
+				const tou::vector_reader&	m_reader;
+				const font&					m_font;
+				const index&				m_local_subrs;
+				path&						m_out;
+				int32_t						m_global_bias;
+				int32_t						m_local_bias;
+
+				float		m_stack[MAX_STACK] = {};
+				int			m_sp = 0;
+				int			m_bottom = 0; // 1 while a width operand sits under the arguments of the current operator
+				float		m_transients[NUM_TRANSIENTS] = {};
+				float		m_x = 0.0f, m_y = 0.0f;
+				uint32_t	m_num_stems = 0;
+				bool		m_width_checked = false;
+				bool		m_open = false;
+				bool		m_ended = false;
+			};
+
+			bool interpreter::m_call(const index& subrs, int32_t bias, int depth)
+			{
+				if (m_sp < 1 || depth + 1 > MAX_SUBR_DEPTH)
+					return false;
+				int32_t i = static_cast<int32_t>(m_stack[--m_sp]) + bias;
+				if (i < 0 || static_cast<uint32_t>(i) >= subrs.count())
+					return false;
+				return m_run(subrs.offsets[i], subrs.offsets[i + 1], depth + 1);
+			}
+
+			bool interpreter::m_run(uint32_t begin, uint32_t end, int depth)
+			{
+				// every frame reads through its own copy so the bytes of its caller stay valid in partial mode
+				tou::vector_reader reader = m_reader;
+				const char* b = reader.get_bytes(begin, end - begin);
+				size_t n = end - begin;
+				if (!b)
+					return false;
+
+				for (size_t i = 0; i < n && !m_ended;)
+				{
+					uint8_t b0 = static_cast<uint8_t>(b[i++]);
+
+					// operands
+					if (b0 >= 32 || b0 == 28)
+					{
+						if (m_sp >= MAX_STACK)
+							return false;
+						if (b0 == 28)
+						{
+							if (i + 2 > n)
+								return false;
+							m_stack[m_sp++] = static_cast<int16_t>((static_cast<uint8_t>(b[i]) << 8) | static_cast<uint8_t>(b[i + 1]));
+							i += 2;
+						}
+						else if (b0 <= 246)
+							m_stack[m_sp++] = static_cast<float>(static_cast<int32_t>(b0) - 139);
+						else if (b0 <= 254)
+						{
+							if (i >= n)
+								return false;
+							int32_t b1 = static_cast<uint8_t>(b[i++]);
+							m_stack[m_sp++] = static_cast<float>(b0 <= 250 ? (b0 - 247) * 256 + b1 + 108 : -(b0 - 251) * 256 - b1 - 108);
+						}
+						else
+						{
+							// 16.16 fixed
+							if (i + 4 > n)
+								return false;
+							m_stack[m_sp++] = static_cast<int32_t>(read_offset(b + i, 4)) / 65536.0f;
+							i += 4;
+						}
+						continue;
+					}
+
+					switch (b0)
+					{
+					case 1: case 3: case 18: case 23: // hstem, vstem, hstemhm, vstemhm
+						m_skip_width(m_sp % 2 == 1);
+						m_num_stems += m_args() / 2;
+						m_clear();
+						break;
+					case 19: case 20: // hintmask, cntrmask, the arguments are an implied vstem
+						m_skip_width(m_sp % 2 == 1);
+						m_num_stems += m_args() / 2;
+						m_clear();
+						i += (m_num_stems + 7) / 8;
+						if (i > n)
+							return false;
+						break;
+					case 21: // rmoveto
+						m_skip_width(m_sp > 2);
+						if (m_args() < 2)
+							return false;
+						m_move(m_arg(0), m_arg(1));
+						m_clear();
+						break;
+					case 22: // hmoveto
+						m_skip_width(m_sp > 1);
+						if (m_args() < 1)
+							return false;
+						m_move(m_arg(0), 0.0f);
+						m_clear();
+						break;
+					case 4: // vmoveto
+						m_skip_width(m_sp > 1);
+						if (m_args() < 1)
+							return false;
+						m_move(0.0f, m_arg(0));
+						m_clear();
+						break;
+					case 5: // rlineto
+						for (int a = 0; a + 1 < m_args(); a += 2)
+							m_line(m_arg(a), m_arg(a + 1));
+						m_clear();
+						break;
+					case 6: case 7: // hlineto, vlineto, alternating horizontal and vertical lines
+					{
+						bool horizontal = b0 == 6;
+						for (int a = 0; a < m_args(); a++, horizontal = !horizontal)
+							horizontal ? m_line(m_arg(a), 0.0f) : m_line(0.0f, m_arg(a));
+						m_clear();
+						break;
+					}
+					case 8: // rrcurveto
+						for (int a = 0; a + 5 < m_args(); a += 6)
+							m_curve(m_arg(a), m_arg(a + 1), m_arg(a + 2), m_arg(a + 3), m_arg(a + 4), m_arg(a + 5));
+						m_clear();
+						break;
+					case 24: // rcurveline
+					{
+						int a = 0;
+						for (; a + 5 < m_args() - 2; a += 6)
+							m_curve(m_arg(a), m_arg(a + 1), m_arg(a + 2), m_arg(a + 3), m_arg(a + 4), m_arg(a + 5));
+						if (a + 1 < m_args())
+							m_line(m_arg(a), m_arg(a + 1));
+						m_clear();
+						break;
+					}
+					case 25: // rlinecurve
+					{
+						int a = 0;
+						for (; a + 1 < m_args() - 6; a += 2)
+							m_line(m_arg(a), m_arg(a + 1));
+						if (a + 5 < m_args())
+							m_curve(m_arg(a), m_arg(a + 1), m_arg(a + 2), m_arg(a + 3), m_arg(a + 4), m_arg(a + 5));
+						m_clear();
+						break;
+					}
+					case 26: // vvcurveto
+					{
+						int a = 0;
+						float dx1 = 0.0f;
+						if (m_args() % 2 == 1)
+							dx1 = m_arg(a++);
+						for (; a + 3 < m_args(); a += 4, dx1 = 0.0f)
+							m_curve(dx1, m_arg(a), m_arg(a + 1), m_arg(a + 2), 0.0f, m_arg(a + 3));
+						m_clear();
+						break;
+					}
+					case 27: // hhcurveto
+					{
+						int a = 0;
+						float dy1 = 0.0f;
+						if (m_args() % 2 == 1)
+							dy1 = m_arg(a++);
+						for (; a + 3 < m_args(); a += 4, dy1 = 0.0f)
+							m_curve(m_arg(a), dy1, m_arg(a + 1), m_arg(a + 2), m_arg(a + 3), 0.0f);
+						m_clear();
+						break;
+					}
+					case 30: case 31: // vhcurveto, hvcurveto, alternating start tangents with an optional final delta
+					{
+						bool horizontal = b0 == 31;
+						for (int a = 0; a + 3 < m_args(); a += 4, horizontal = !horizontal)
+						{
+							float last = (a + 5 == m_args()) ? m_arg(a + 4) : 0.0f;
+							if (horizontal)
+								m_curve(m_arg(a), 0.0f, m_arg(a + 1), m_arg(a + 2), last, m_arg(a + 3));
+							else
+								m_curve(0.0f, m_arg(a), m_arg(a + 1), m_arg(a + 2), m_arg(a + 3), last);
+						}
+						m_clear();
+						break;
+					}
+					case 10: // callsubr
+						if (!m_call(m_local_subrs, m_local_bias, depth))
+							return false;
+						break;
+					case 29: // callgsubr
+						if (!m_call(m_font.global_subrs, m_global_bias, depth))
+							return false;
+						break;
+					case 11: // return
+						return true;
+					case 14: // endchar, the 4 extra seac operands of accented glyphs are ignored
+						m_skip_width(m_sp == 1 || m_sp == 5);
+						m_clear();
+						m_ended = true;
+						break;
+					case 12:
+						if (i >= n || !m_escape(static_cast<uint8_t>(b[i++])))
+							return false;
+						break;
+					default:
+						return false;
+					}
+				}
+				return true;
+			}
+
+			bool interpreter::m_escape(uint8_t op)
+			{
+				auto need = [&](int count) { return m_args() >= count; };
+
+				switch (op)
+				{
+				case 35: // flex
+					if (!need(13))
+						return false;
+					m_curve(m_arg(0), m_arg(1), m_arg(2), m_arg(3), m_arg(4), m_arg(5));
+					m_curve(m_arg(6), m_arg(7), m_arg(8), m_arg(9), m_arg(10), m_arg(11));
+					m_clear();
+					return true;
+				case 34: // hflex
+					if (!need(7))
+						return false;
+					m_curve(m_arg(0), 0.0f, m_arg(1), m_arg(2), m_arg(3), 0.0f);
+					m_curve(m_arg(4), 0.0f, m_arg(5), -m_arg(2), m_arg(6), 0.0f);
+					m_clear();
+					return true;
+				case 36: // hflex1
+					if (!need(9))
+						return false;
+					m_curve(m_arg(0), m_arg(1), m_arg(2), m_arg(3), m_arg(4), 0.0f);
+					m_curve(m_arg(5), 0.0f, m_arg(6), m_arg(7), m_arg(8), -(m_arg(1) + m_arg(3) + m_arg(7)));
+					m_clear();
+					return true;
+				case 37: // flex1, the last delta runs along whichever axis moved further
+				{
+					if (!need(11))
+						return false;
+					float dx = 0.0f, dy = 0.0f;
+					for (int a = 0; a < 10; a += 2)
+					{
+						dx += m_arg(a);
+						dy += m_arg(a + 1);
+					}
+					m_curve(m_arg(0), m_arg(1), m_arg(2), m_arg(3), m_arg(4), m_arg(5));
+					if (std::fabs(dx) > std::fabs(dy))
+						m_curve(m_arg(6), m_arg(7), m_arg(8), m_arg(9), m_arg(10), -dy);
+					else
+						m_curve(m_arg(6), m_arg(7), m_arg(8), m_arg(9), -dx, m_arg(10));
+					m_clear();
+					return true;
+				}
+				default:
+					break;
+				}
+
+				// arithmetic and storage operators work on the stack top and don't clear it
+				float* s = m_stack;
+				int& sp = m_sp;
+				switch (op)
+				{
+				case 9: if (sp < 1) return false; s[sp - 1] = std::fabs(s[sp - 1]); return true;												// abs
+				case 10: if (sp < 2) return false; s[sp - 2] += s[sp - 1]; sp--; return true;													// add
+				case 11: if (sp < 2) return false; s[sp - 2] -= s[sp - 1]; sp--; return true;													// sub
+				case 12: if (sp < 2 || s[sp - 1] == 0.0f) return false; s[sp - 2] /= s[sp - 1]; sp--; return true;								// div
+				case 14: if (sp < 1) return false; s[sp - 1] = -s[sp - 1]; return true;														// neg
+				case 24: if (sp < 2) return false; s[sp - 2] *= s[sp - 1]; sp--; return true;													// mul
+				case 26: if (sp < 1 || s[sp - 1] < 0.0f) return false; s[sp - 1] = std::sqrt(s[sp - 1]); return true;						// sqrt
+				case 18: if (sp < 1) return false; sp--; return true;																		// drop
+				case 3: if (sp < 2) return false; s[sp - 2] = (s[sp - 2] != 0.0f && s[sp - 1] != 0.0f) ? 1.0f : 0.0f; sp--; return true;	// and
+				case 4: if (sp < 2) return false; s[sp - 2] = (s[sp - 2] != 0.0f || s[sp - 1] != 0.0f) ? 1.0f : 0.0f; sp--; return true;	// or
+				case 5: if (sp < 1) return false; s[sp - 1] = s[sp - 1] == 0.0f ? 1.0f : 0.0f; return true;								// not
+				case 15: if (sp < 2) return false; s[sp - 2] = s[sp - 2] == s[sp - 1] ? 1.0f : 0.0f; sp--; return true;						// eq
+				case 22: if (sp < 4) return false; s[sp - 4] = s[sp - 2] <= s[sp - 1] ? s[sp - 4] : s[sp - 3]; sp -= 3; return true;		// ifelse
+				case 23: if (sp >= MAX_STACK) return false; s[sp++] = 0.5f; return true;													// random, deterministic here
+				case 27: if (sp < 1 || sp >= MAX_STACK) return false; s[sp] = s[sp - 1]; sp++; return true;								// dup
+				case 28: if (sp < 2) return false; std::swap(s[sp - 2], s[sp - 1]); return true;											// exch
+				case 29: // index
+				{
+					if (sp < 1)
+						return false;
+					int i = static_cast<int>(s[sp - 1]);
+					if (i < 0)
+						i = 0;
+					if (i > sp - 2)
+						return false;
+					s[sp - 1] = s[sp - 2 - i];
+					return true;
+				}
+				case 30: // roll
+				{
+					if (sp < 2)
+						return false;
+					int count = static_cast<int>(s[sp - 2]);
+					int shift = static_cast<int>(s[sp - 1]);
+					sp -= 2;
+					if (count < 0 || count > sp)
+						return false;
+					if (count > 0)
+					{
+						shift = ((shift % count) + count) % count;
+						std::rotate(s + sp - count, s + sp - shift, s + sp);
+					}
+					return true;
+				}
+				case 20: // put
+				{
+					if (sp < 2)
+						return false;
+					int i = static_cast<int>(s[sp - 1]);
+					if (i < 0 || i >= NUM_TRANSIENTS)
+						return false;
+					m_transients[i] = s[sp - 2];
+					sp -= 2;
+					return true;
+				}
+				case 21: // get
+				{
+					if (sp < 1)
+						return false;
+					int i = static_cast<int>(s[sp - 1]);
+					if (i < 0 || i >= NUM_TRANSIENTS)
+						return false;
+					s[sp - 1] = m_transients[i];
+					return true;
+				}
+				default:
+					return false;
+				}
+			}
+		}
+
+		bool parse_font(tou::vector_reader& reader, uint64_t offset, uint64_t length, uint16_t num_glyphs, font& out)
+		{
+			out = {};
+			uint64_t end = offset + length;
+			if (length < 4)
+				return false;
+
+			reader.set_position(offset);
+			uint8_t major = reader.get_uint8();
+			reader.get_uint8(); // minor
+			uint8_t header_size = reader.get_uint8();
+			if (major != 1)
+				return false;
+
+			index names, top_dicts, strings;
+			uint64_t position = read_index(reader, offset + header_size, end, names);
+			if (position)
+				position = read_index(reader, position, end, top_dicts);
+			if (position)
+				position = read_index(reader, position, end, strings);
+			if (position)
+				position = read_index(reader, position, end, out.global_subrs);
+			if (!position || top_dicts.count() < 1)
+				return false;
+
+			// an OpenType CFF table holds a single font
+			dict top;
+			if (!parse_dict(reader, top_dicts.offsets[0], top_dicts.offsets[1], top))
+				return false;
+
+			const std::vector<int32_t>* type = top.find(DICT_CHARSTRING_TYPE);
+			if (type && (type->size() != 1 || (*type)[0] != 2))
+				return false;
+
+			const std::vector<int32_t>* charstrings = top.find(DICT_CHARSTRINGS);
+			if (!charstrings || charstrings->size() != 1 || (*charstrings)[0] < 0)
+				return false;
+			if (!read_index(reader, offset + static_cast<uint32_t>((*charstrings)[0]), end, out.charstrings) || out.charstrings.count() == 0)
+				return false;
+
+			if (!top.find(DICT_ROS))
+			{
+				out.local_subrs.resize(1);
+				return read_private_subrs(reader, top, offset, end, out.local_subrs[0]);
+			}
+
+			// CID-keyed, each font dict has a Private DICT of its own and FDSelect assigns glyphs to them
+			const std::vector<int32_t>* fd_array = top.find(DICT_FDARRAY);
+			const std::vector<int32_t>* fd_select = top.find(DICT_FDSELECT);
+			if (!fd_array || !fd_select || fd_array->size() != 1 || fd_select->size() != 1 || (*fd_array)[0] < 0 || (*fd_select)[0] < 0)
+				return false;
+
+			index font_dicts;
+			if (!read_index(reader, offset + static_cast<uint32_t>((*fd_array)[0]), end, font_dicts) || font_dicts.count() == 0 || font_dicts.count() > 256)
+				return false;
+
+			out.local_subrs.resize(font_dicts.count());
+			for (uint32_t i = 0; i < font_dicts.count(); i++)
+			{
+				dict font_dict;
+				if (!parse_dict(reader, font_dicts.offsets[i], font_dicts.offsets[i + 1], font_dict) ||
+					!read_private_subrs(reader, font_dict, offset, end, out.local_subrs[i]))
+					return false;
+			}
+
+			return read_fd_select(reader, offset + static_cast<uint32_t>((*fd_select)[0]), end, num_glyphs, out.local_subrs.size(), out.fd_select);
+		}
+
+		bool decode_glyph(const tou::vector_reader& reader, const font& f, uint16_t glyph_id, path& out)
+		{
+			out.ops.clear();
+			out.points.clear();
+			if (glyph_id >= f.charstrings.count() || f.local_subrs.empty())
+				return false;
+
+			size_t fd = glyph_id < f.fd_select.size() ? f.fd_select[glyph_id] : 0;
+			interpreter interp(reader, f, f.local_subrs[fd], out);
+			return interp.run(f.charstrings.offsets[glyph_id], f.charstrings.offsets[glyph_id + 1]);
+		}
+	}
+}
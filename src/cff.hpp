@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "util.hpp"
+
+namespace tou
+{
+	namespace cff
+	{
+		// an INDEX reduced to the absolute file position of each object, object i spans [offsets[i], offsets[i + 1])
+		struct index
+		{
+			std::vector<uint32_t> offsets;
+
+			uint32_t count() const { return offsets.empty() ? 0 : static_cast<uint32_t>(offsets.size() - 1); }
+		};
+
+		// what running a charstring needs, decoded once per face so subroutine calls don't walk INDEX structures
+		struct font
+		{
+			index charstrings;
+			index global_subrs;
+			std::vector<index> local_subrs;		// one per font dict, a single entry for name-keyed fonts
+			std::vector<uint8_t> fd_select;		// font dict of each glyph, empty for name-keyed fonts
+		};
+
+		enum class path_op : uint8_t
+		{
+			move_to,	// 1 point
+			line_to,	// 1 point
+			cubic_to	// 2 control points and the end point
+		};
+
+		// outline of a glyph in font units, every contour starts with a move_to and is implicitly closed
+		struct path
+		{
+			std::vector<path_op> ops;
+			std::vector<tou::fvec2> points;
+		};
+
+		// parses the CFF table at [offset, offset + length), fails on CFF2 and on charstring types other than 2
+		bool parse_font(tou::vector_reader& reader, uint64_t offset, uint64_t length, uint16_t num_glyphs, font& out);
+
+		// runs the Type 2 charstring of a glyph, hints are skipped
+		bool decode_glyph(const tou::vector_reader& reader, const font& f, uint16_t glyph_id, path& out);
+	}
+}
@@ -1,7 +1,15 @@
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
 #include "font_face.hpp"
 
 #define FILL_BLK { 0x00, 0x00, 0x00, 0xFF }
+#define RENDER_DPI 300.0f // glyph bitmaps are rendered at a fixed resolution
 #define FIND(m, y, x) std::find(m[y].begin(), m[y].end(), x)  != m[y].end()
 #define FINDV(v, n) std::find(v.begin(), v.end(), n) != v.end()
 #define FINDV_IT(v, n) std::find(v.begin(), v.end(), n)
@@ -375,6 +383,39 @@ namespace tou
 	constexpr uint8_t Y_IS_SAME_OR_POSITIVE_Y_SHORT_VECTOR = 0x20;
 	constexpr uint8_t OVERLAP_SIMPLE = 0x40;
 
+	// what each flag byte means for the coordinate streams: bits 0-1 are the byte width of the x delta and bit 2 negates
+	// a one byte delta, bits 4-6 the same for y
+	constexpr uint8_t DELTA_WIDTH = 0x03;
+	constexpr uint8_t DELTA_NEGATIVE = 0x04;
+	constexpr std::array<uint8_t, 256> make_delta_layouts()
+	{
+		std::array<uint8_t, 256> layouts{};
+		for (uint32_t flag = 0; flag < 256; flag++)
+		{
+			auto layout = [flag](uint8_t short_vector, uint8_t same_or_positive) -> uint8_t
+			{
+				if (flag & short_vector)
+					return (flag & same_or_positive) ? 1 : 1 | DELTA_NEGATIVE;
+				return (flag & same_or_positive) ? 0 : 2; // a long vector is either repeated or a signed 16-bit delta
+			};
+			layouts[flag] = static_cast<uint8_t>(layout(X_SHORT_VECTOR, X_IS_SAME_OR_POSITIVE_X_SHORT_VECTOR) |
+				(layout(Y_SHORT_VECTOR, Y_IS_SAME_OR_POSITIVE_Y_SHORT_VECTOR) << 4));
+		}
+		return layouts;
+	}
+	constexpr std::array<uint8_t, 256> DELTA_LAYOUTS = make_delta_layouts();
+
+	// the delta at p described by a layout nibble, p is advanced past it
+	// two bytes at p are read whatever the width, so a stream needs two readable bytes past its last delta
+	inline int16_t read_delta(const uint8_t*& p, uint8_t layout)
+	{
+		const uint8_t width = layout & DELTA_WIDTH;
+		const int16_t wide = static_cast<int16_t>((p[0] << 8) | p[1]);
+		const int16_t narrow = (layout & DELTA_NEGATIVE) ? -p[0] : p[0];
+		p += width;
+		return width == 2 ? wide : (width == 1 ? narrow : 0);
+	}
+
 	constexpr uint16_t ARG_1_AND_2_ARE_WORDS = 0x0001;
 	constexpr uint16_t ARGS_ARE_XY_VALUES = 0x0002;
 	constexpr uint16_t ROUND_XY_TO_GRID = 0x0004;
@@ -388,468 +429,1676 @@ namespace tou
 	constexpr uint16_t SCALED_COMPONENT_OFFSET = 0x0800;
 	constexpr uint16_t UNSCALED_COMPONENT_OFFSET = 0x1000;
 
+	// positions 'directory_offset' at the offset table of face 'face_index'
+	// a plain font file is treated as a collection holding a single face
+	bool read_collection_header(tou::vector_reader& reader, uint32_t face_index, uint64_t& directory_offset)
+	{
+		reader.set_position(0);
+		if (reader.get_uint32() != truetype::TAG_TTCF)
+		{
+			directory_offset = 0;
+			if (face_index != 0)
+			{
+				LOG("Face " << face_index << " was requested but the font file is not a collection");
+				return false;
+			}
+			return true;
+		}
+
+		reader.increment_position(4); // major and minor version
+		uint32_t num_fonts = reader.get_uint32();
+		if (face_index >= num_fonts)
+		{
+			LOG("Face " << face_index << " was requested but the collection only holds " << num_fonts << " faces");
+			return false;
+		}
+		reader.pin(0, 12 + (uint64_t)num_fonts * 4);
+		reader.set_position(12 + (uint64_t)face_index * 4);
+		directory_offset = reader.get_uint32();
+		return true;
+	}
+
+	font_collection::font_collection()
+		:m_ok(false), m_num_faces(0)
+	{
+	}
+
+	font_collection::font_collection(const std::string& filepath, const tou::font_load_options& options)
+		:m_ok(false), m_num_faces(0)
+	{
+		m_ok = load(filepath, options);
+	}
+
+	bool font_collection::load(const std::string& filepath, const tou::font_load_options& options)
+	{
+		m_ok = false;
+		m_num_faces = 0;
+		if (options.partial)
+		{
+			if (!m_reader.load_partial(filepath, options.page_cache_bytes))
+				return false;
+		}
+		else if (!m_reader.load(filepath))
+			return false;
+
+		m_reader.set_position(0);
+		if (m_reader.get_uint32() == truetype::TAG_TTCF)
+		{
+			m_reader.increment_position(4);
+			m_num_faces = m_reader.get_uint32();
+		}
+		else
+			m_num_faces = 1;
+
+		m_filepath = filepath;
+		m_shared_tables = std::make_shared<font_collection::shared_tables>();
+		m_ok = true;
+		return m_ok;
+	}
+
+	std::shared_ptr<const void> font_collection::shared_tables::get(const key& k, const std::function<std::shared_ptr<const void>()>& decode)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = tables.find(k);
+		if (it != tables.end())
+			return it->second;
+		std::shared_ptr<const void> table = decode();
+		tables.insert({ k, table });
+		return table;
+	}
+
+	// identifies the font by its absolute path (plus the face index for faces of a collection), size and modification time
+	bool get_font_file_key(const std::string& filepath, std::string& absolute_path, uint32_t face_index, uint64_t& size, int64_t& mtime)
+	{
+		std::error_code ec;
+		absolute_path = std::filesystem::absolute(filepath, ec).lexically_normal().string();
+		if (ec) return false;
+		if (face_index != 0)
+			absolute_path += "#" + std::to_string(face_index);
+		size = std::filesystem::file_size(filepath, ec);
+		if (ec) return false;
+		auto time = std::filesystem::last_write_time(filepath, ec);
+		if (ec) return false;
+		mtime = static_cast<int64_t>(time.time_since_epoch().count());
+		return true;
+	}
+
+	// faces opened from the same file with the same options share one face_data while any of them is alive
+	struct open_face_registry
+	{
+		std::mutex mutex;
+		std::map<std::string, std::weak_ptr<void>> faces;
+	};
+
+	open_face_registry& get_open_face_registry()
+	{
+		static open_face_registry registry;
+		return registry;
+	}
+
+	// empty if the file can't be identified, such a load is never shared
+	std::string get_open_face_key(const std::string& filepath, const tou::font_load_options& options)
+	{
+		std::string absolute_path;
+		uint64_t size = 0;
+		int64_t mtime = 0;
+		if (!get_font_file_key(filepath, absolute_path, options.face_index, size, mtime))
+			return std::string();
+
+		std::ostringstream key;
+		key << absolute_path << '\n' << size << ' ' << mtime << ' ' << options.lazy_tables << options.partial << options.validate
+			<< options.dense_cmap << ' ' << options.page_cache_bytes << ' ' << options.cache_directory;
+		return key.str();
+	}
+
 	font_face::font_face()
-		:m_ok(false), m_sfnt(0x00010000), m_num_glyphs(0), m_units_per_em(0), m_seg_count(0), m_id_range_offset_from_filestart(0)
+		:m_data(std::make_shared<font_face::face_data>()), m_lookup(std::make_unique<font_face::lookup_state>()), m_ok(false)
 	{
 	}
 
-	font_face::font_face(const std::string& filepath)
-		: m_ok(false), m_sfnt(0x00010000), m_num_glyphs(0), m_units_per_em(0),  m_seg_count(0), m_id_range_offset_from_filestart(0)
+	font_face::font_face(const std::string& filepath, const tou::font_load_options& options)
+		:m_data(std::make_shared<font_face::face_data>()), m_lookup(std::make_unique<font_face::lookup_state>()), m_ok(false)
 	{
-		m_ok = load(filepath);
+		m_ok = load(filepath, options);
+	}
+
+	font_face::font_face(const tou::font_collection& collection, uint32_t face_index, const tou::font_load_options& options)
+		:m_data(std::make_shared<font_face::face_data>()), m_lookup(std::make_unique<font_face::lookup_state>()), m_ok(false)
+	{
+		m_ok = load(collection, face_index, options);
+	}
+
+	font_face::font_face(const font_face& other)
+		:m_data(other.m_data), m_lookup(std::make_unique<font_face::lookup_state>()), m_ok(other.m_ok)
+	{
+		std::lock_guard<std::mutex> lock(other.m_lookup->mutex);
+		m_lookup->select_instance(other.m_lookup->instance.load()->coordinates);
+		m_lookup->cache_limit = other.m_lookup->cache_limit.load();
+	}
+
+	font_face& font_face::operator=(const font_face& other)
+	{
+		if (this != &other)
+		{
+			m_data = other.m_data;
+			m_lookup = std::make_unique<font_face::lookup_state>();
+			m_ok = other.m_ok;
+
+			std::lock_guard<std::mutex> lock(other.m_lookup->mutex);
+			m_lookup->select_instance(other.m_lookup->instance.load()->coordinates);
+			m_lookup->cache_limit = other.m_lookup->cache_limit.load();
+		}
+		return *this;
+	}
+
+	font_face::glyph_cache::glyph_cache(const std::vector<int16_t>& instance_coordinates)
+		:coordinates(instance_coordinates)
+	{
+	}
+
+	font_face::glyph_cache::~glyph_cache()
+	{
+		for (auto& p : pages)
+			delete p.load();
+	}
+
+	const font_face::truetype_glyph* font_face::glyph_cache::find(uint16_t glyph_id) const
+	{
+		const page* p = pages[glyph_id >> 8].load(std::memory_order_acquire);
+		return p ? p->glyphs[glyph_id & 0xff].load(std::memory_order_acquire) : nullptr;
+	}
+
+	font_face::glyph_cache::page& font_face::glyph_cache::page_of(uint16_t glyph_id)
+	{
+		// a page spans every shard, threads racing to allocate it keep the first one published
+		page* p = pages[glyph_id >> 8].load(std::memory_order_acquire);
+		if (!p)
+		{
+			page* fresh = new page();
+			if (pages[glyph_id >> 8].compare_exchange_strong(p, fresh, std::memory_order_acq_rel))
+				p = fresh;
+			else
+				delete fresh;
+		}
+		return *p;
+	}
+
+	font_face::lookup_state::lookup_state()
+	{
+		instances.push_back(std::make_unique<font_face::glyph_cache>(std::vector<int16_t>()));
+		instance = instances.front().get();
+	}
+
+	void font_face::lookup_state::select_instance(const std::vector<int16_t>& coordinates)
+	{
+		if (std::all_of(coordinates.begin(), coordinates.end(), [](int16_t c) { return c == 0; }))
+		{
+			instance = instances.front().get();
+			return;
+		}
+
+		auto it = std::find_if(instances.begin(), instances.end(), [&coordinates](const auto& c) { return c->coordinates == coordinates; });
+		if (it == instances.end())
+		{
+			instances.push_back(std::make_unique<font_face::glyph_cache>(coordinates));
+			it = instances.end() - 1;
+		}
+		instance = it->get();
+	}
+
+	std::shared_ptr<const font_face::truetype_glyph> font_face::lookup_state::find_glyph(font_face::glyph_cache& cache, uint16_t glyph_id)
+	{
+		if (!cache.find(glyph_id))
+			return nullptr;
+		std::shared_lock<std::shared_mutex> lock(shard_of(glyph_id).mutex);
+		return cache.page_of(glyph_id).owners[glyph_id & 0xff];
+	}
+
+	std::shared_ptr<const font_face::truetype_glyph> font_face::lookup_state::add_glyph(font_face::glyph_cache& cache, uint16_t glyph_id, font_face::truetype_glyph&& glyph)
+	{
+		std::shared_ptr<const font_face::truetype_glyph> added;
+		{
+			std::unique_lock<std::shared_mutex> lock(shard_of(glyph_id).mutex);
+			font_face::glyph_cache::page& p = cache.page_of(glyph_id);
+			std::shared_ptr<const font_face::truetype_glyph>& owner = p.owners[glyph_id & 0xff];
+			if (owner)
+				return owner;
+			owner = std::make_shared<const font_face::truetype_glyph>(std::move(glyph));
+			p.glyphs[glyph_id & 0xff].store(owner.get(), std::memory_order_release);
+			added = owner;
+		}
+
+		// the shard lock is released first, evicting takes the shard locks of the outlines it drops
+		std::lock_guard<std::mutex> lock(mutex);
+		cached.emplace_back(&cache, glyph_id);
+		if (cache_limit != 0)
+			evict(cache_limit);
+		return added;
+	}
+
+	void font_face::lookup_state::evict(size_t limit)
+	{
+		while (cached.size() > limit)
+		{
+			uint16_t glyph_id = cached.front().second;
+			std::unique_lock<std::shared_mutex> lock(shard_of(glyph_id).mutex);
+			font_face::glyph_cache::page& p = cached.front().first->page_of(glyph_id);
+			p.glyphs[glyph_id & 0xff].store(nullptr, std::memory_order_release);
+			p.owners[glyph_id & 0xff].reset();
+			cached.pop_front();
+		}
 	}
 
 	font_face::~font_face()
 	{
 	}
 
-	bool font_face::load(const std::string& filepath)
+	bool font_face::load(const std::string& filepath, const tou::font_load_options& options)
 	{
 		// we assume a ttf file has been provided for parsing
+		m_ok = false;
+		m_lookup = std::make_unique<font_face::lookup_state>();
+
+		open_face_registry& registry = get_open_face_registry();
+		std::string key = get_open_face_key(filepath, options);
+		if (!key.empty())
+		{
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			auto it = registry.faces.find(key);
+			std::shared_ptr<void> data = (it != registry.faces.end()) ? it->second.lock() : nullptr;
+			if (data)
+			{
+				m_data = std::static_pointer_cast<font_face::face_data>(data);
+				m_ok = true;
+				return true;
+			}
+		}
+
+		// parsed without holding the registry lock, if another thread opens the same font meanwhile the last one registered is kept
+		m_data = std::make_shared<font_face::face_data>();
+		m_data->options = options;
+		if (m_data->options.partial)
+		{
+			if (!m_data->reader.load_partial(filepath, m_data->options.page_cache_bytes))
+				return false;
+		}
+		else if (!m_data->reader.load(filepath))
+			return false;
+
 		m_ok = m_parse_truetype_file(filepath);
+		if (m_ok && !key.empty())
+		{
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			for (auto it = registry.faces.begin(); it != registry.faces.end();)
+				it = it->second.expired() ? registry.faces.erase(it) : std::next(it);
+			registry.faces[key] = m_data;
+		}
+		return m_ok;
+	}
+
+	bool font_face::load(const tou::font_collection& collection, uint32_t face_index, const tou::font_load_options& options)
+	{
+		// the face reads from the collection's byte source and shares decoded tables with the other faces loaded from it
+		m_ok = false;
+		m_lookup = std::make_unique<font_face::lookup_state>();
+		m_data = std::make_shared<font_face::face_data>();
+		m_data->options = options;
+		m_data->options.face_index = face_index;
+		if (!collection.ok())
+			return false;
+
+		m_data->reader = collection.m_reader;
+		m_data->shared_tables = collection.m_shared_tables;
+		m_ok = m_parse_truetype_file(collection.m_filepath);
 		return m_ok;
 	}
 
-	const font_face::truetype_glyph& font_face::get_glyph(uint16_t unicode)
+	const font_face::truetype_glyph& font_face::get_glyph(uint32_t unicode)
+	{
+		return m_get_cached_glyph(unicode, nullptr);
+	}
+
+	const font_face::truetype_glyph& font_face::m_get_cached_glyph(uint32_t unicode, std::shared_ptr<const font_face::truetype_glyph>* owner)
+	{
+		// every call decodes through its own cursor over the shared byte source, so lookups can run on several threads at once,
+		// it is left unbound until something has to be read since copying it counts a reference every thread shares
+		tou::vector_reader reader;
+		uint16_t glyph_id = m_get_truetype_glyph_id(reader, unicode);
+		if (glyph_id == 0)
+			LOG("The requested glyph could not be found in the font file");
+
+		// with a cache limit another thread can evict the outline while the caller still reads it, so get_glyph keeps a reference
+		// on it for the calling thread until its next lookup, the outlines of a face without a limit live as long as the face
+		thread_local std::shared_ptr<const font_face::truetype_glyph> in_use;
+		if (!owner && m_lookup->cache_limit.load(std::memory_order_relaxed) != 0)
+			owner = &in_use;
+
+		// a hit takes no lock and, unless a reference on the outline is wanted, touches no count shared between threads
+		font_face::glyph_cache& instance = *m_lookup->instance.load(std::memory_order_acquire);
+		if (const font_face::truetype_glyph* glyph = instance.find(glyph_id))
+		{
+			if (!owner)
+				return *glyph;
+			if ((*owner = m_lookup->find_glyph(instance, glyph_id)))
+				return **owner;
+		}
+
+		if (reader.size() == 0)
+			reader = m_data->reader;
+		std::shared_ptr<const font_face::truetype_glyph> glyph = m_get_cached_glyph_by_id(reader, glyph_id, instance, {});
+		if (owner)
+			*owner = glyph;
+		return *glyph;
+	}
+
+	std::shared_ptr<const font_face::truetype_glyph> font_face::m_get_cached_glyph_by_id(tou::vector_reader& reader, uint16_t glyph_id, font_face::glyph_cache& instance, const font_face::component_path& path)
+	{
+		// m_get_cached_glyph has already looked for the top level glyph
+		// a cached component is only used where decoding it again would give the same outline, when its components fit
+		// in what is left of the depth limit below the path
+		if (path.depth != 0)
+		{
+			const uint16_t depth_limit = std::clamp<uint16_t>(m_data->max_component_depth, 1, MAX_COMPONENT_DEPTH);
+			std::shared_ptr<const font_face::truetype_glyph> glyph = m_lookup->find_glyph(instance, glyph_id);
+			if (glyph && !glyph->components_left_out && path.depth + glyph->component_depth <= depth_limit)
+				return glyph;
+		}
+
+		// decode outside the lock
+		font_face::truetype_glyph glyph = m_get_truetype_glyph(reader, glyph_id, instance, path);
+
+		// a component cut short by the depth limit or a cycle depends on the composites above it, it isn't cached under its own id
+		if (path.depth != 0 && glyph.components_left_out)
+			return std::make_shared<const font_face::truetype_glyph>(std::move(glyph));
+		return m_lookup->add_glyph(instance, glyph_id, std::move(glyph));
+	}
+
+	font_face::bitmap_glyph font_face::get_glyph_bitmap(uint32_t unicode, float point_size, bool render_outline, bool render_inside)
+	{
+		font_face::bitmap_glyph bitmap;
+		if (m_data->bitmap_strikes && m_draw_embedded_bitmap(unicode, point_size, bitmap))
+			return bitmap;
+
+		// holding the outline keeps it alive if the cache drops it while it is rasterized
+		std::shared_ptr<const font_face::truetype_glyph> g;
+		m_get_cached_glyph(unicode, &g);
+
+		if (g->id == 0) LOG("An empty glyph was returned as a bitmap");
+
+		return m_rasterize_truetype_glyph(*g, point_size, render_outline, render_inside);
+	}
+
+	const std::vector<tou::variations::axis>& font_face::get_variation_axes() const
+	{
+		static const std::vector<tou::variations::axis> no_axes;
+		return m_data->variations ? m_data->variations->axes : no_axes;
+	}
+
+	bool font_face::set_variation(const std::vector<std::pair<uint32_t, float>>& coordinates)
+	{
+		if (!m_data->variations)
+		{
+			if (coordinates.empty())
+				return true;
+			LOG("The font has no glyph variations");
+			return false;
+		}
+
+		const std::vector<tou::variations::axis>& axes = m_data->variations->axes;
+		std::vector<float> user_coordinates(axes.size());
+		for (size_t i = 0; i < axes.size(); i++)
+			user_coordinates[i] = axes[i].default_value;
+		for (const auto& coordinate : coordinates)
+		{
+			auto it = std::find_if(axes.begin(), axes.end(), [&coordinate](const tou::variations::axis& a) { return a.tag == coordinate.first; });
+			if (it == axes.end())
+			{
+				LOG("The font has no '" << truetype::tag_to_string(coordinate.first) << "' variation axis");
+				return false;
+			}
+			user_coordinates[it - axes.begin()] = coordinate.second;
+		}
+
+		std::vector<int16_t> normalized = tou::variations::normalize(*m_data->variations, user_coordinates);
+		std::lock_guard<std::mutex> lock(m_lookup->mutex);
+		m_lookup->select_instance(normalized);
+		return true;
+	}
+
+	void font_face::set_glyph_cache_limit(size_t glyphs)
+	{
+		std::lock_guard<std::mutex> lock(m_lookup->mutex);
+		m_lookup->cache_limit = glyphs;
+		if (glyphs != 0)
+			m_lookup->evict(glyphs);
+	}
+
+	void font_face::preload(unsigned threads)
+	{
+		if (m_ok && m_data->num_glyphs != 0)
+			preload(0, m_data->num_glyphs - 1, threads);
+	}
+
+	void font_face::preload(uint16_t first_glyph, uint16_t last_glyph, unsigned threads)
+	{
+		if (!m_ok || m_data->num_glyphs == 0)
+			return;
+		last_glyph = std::min<uint16_t>(last_glyph, m_data->num_glyphs - 1);
+		if (first_glyph > last_glyph)
+			return;
+
+		font_face::glyph_cache& instance = *m_lookup->instance.load(std::memory_order_acquire);
+
+		// loca gives every glyph its own byte range, so the ids are handed out in batches to whichever thread is free,
+		// consecutive ids sit in different cache shards so the threads seldom wait on the same lock
+		constexpr uint32_t BATCH = 64;
+		const uint32_t count = (uint32_t)last_glyph - first_glyph + 1;
+		std::atomic<uint32_t> next{ 0 };
+		auto work = [&]()
+		{
+			tou::vector_reader reader = m_data->reader;
+			for (uint32_t begin = next.fetch_add(BATCH); begin < count; begin = next.fetch_add(BATCH))
+			{
+				for (uint32_t i = begin; i < std::min(begin + BATCH, count); i++)
+				{
+					const uint16_t glyph_id = static_cast<uint16_t>(first_glyph + i);
+					if (!instance.find(glyph_id))
+						m_lookup->add_glyph(instance, glyph_id, m_get_truetype_glyph(reader, glyph_id, instance, {}));
+				}
+			}
+		};
+
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = std::min(threads, (count + BATCH - 1) / BATCH);
+		std::vector<std::thread> workers;
+		for (unsigned i = 1; i < threads; i++)
+			workers.emplace_back(work);
+		work();
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	bool font_face::m_parse_truetype_file(const std::string& filepath)
+	{
+		// function assumes m_data->reader has been loaded
+		uint64_t directory_offset = 0;
+		if (!read_collection_header(m_data->reader, m_data->options.face_index, directory_offset))
+			return false;
+
+		if (!m_data->options.cache_directory.empty() && m_load_sidecar(filepath))
+		{
+			// glyph ids are still read from the cmap glyphIdArray in the font file
+			m_data->reader.pin(m_data->cmap_table.offset, m_data->cmap_table.length);
+			m_finish_cmap();
+			m_parse_variations();
+			m_parse_bitmap_strikes();
+			return !m_data->options.validate || m_validate_tables();
+		}
+
+		m_data->reader.set_position(directory_offset);
+		tou::truetype::offset_table offset_table;
+		offset_table.sfnt_version = m_data->reader.get_uint32();
+		if (offset_table.sfnt_version != truetype::SFNT_TRUETYPE && offset_table.sfnt_version != truetype::SFNT_APPLE_TRUE &&
+			offset_table.sfnt_version != truetype::SFNT_OTTO)
+		{
+			LOG("The sfnt version of this font file is unsupported");
+			return false;
+		}
+		m_data->sfnt = offset_table.sfnt_version;
+		const bool cff_outlines = m_data->sfnt == truetype::SFNT_OTTO;
+
+		offset_table.num_tables =		m_data->reader.get_uint16();
+		offset_table.search_range =		m_data->reader.get_uint16();
+		offset_table.entry_selector =	m_data->reader.get_uint16();
+		offset_table.range_shift =		m_data->reader.get_uint16();
+
+		if (m_data->reader.get_position() + (uint64_t)offset_table.num_tables * 16 > m_data->reader.size())
+		{
+			LOG("The table directory extends past the end of the font file");
+			return false;
+		}
+
+		// in partial mode the table directory and the tables read on every lookup stay resident, glyf goes through the page cache
+		m_data->reader.pin(directory_offset, 12 + (uint64_t)offset_table.num_tables * 16);
+
+		m_data->table_records.clear();
+		m_data->table_records.reserve(offset_table.num_tables);
+
+		for (int i = 0; i < offset_table.num_tables; i++)
+		{
+			const char* tag = m_data->reader.get_bytes(m_data->reader.get_position(), 4);
+			if ((tag[0] <= 0x7E && tag[0] >= 0x20) &&
+				(tag[1] <= 0x7E && tag[1] >= 0x20) &&
+				(tag[2] <= 0x7E && tag[2] >= 0x20) &&
+				(tag[3] <= 0x7E && tag[3] >= 0x20))
+			{
+				tou::truetype::table_record record;
+				record.tag =		m_data->reader.get_uint32();
+				record.checksum =	m_data->reader.get_uint32();
+				record.offset =		m_data->reader.get_uint32();
+				record.length =		m_data->reader.get_uint32();
+				
+				m_data->table_records.push_back(record);
+			}
+			else
+			{
+				LOG("The table record contains an invalid tag or the number of tables recorded in the offset table is incorrect.");
+				return false;
+			}
+		}
+
+		// records should already be sorted by tag, but not every font follows the spec and m_find_table binary searches them
+		std::sort(m_data->table_records.begin(), m_data->table_records.end(),
+			[](const tou::truetype::table_record& a, const tou::truetype::table_record& b) { return a.tag < b.tag; });
+
+		if (m_data->options.validate && !m_validate_tables())
+			return false;
+
+		// every table used for glyph lookups must be present and lie within the file, CFF outlines replace glyf and loca
+		const std::vector<uint32_t> required_tables = cff_outlines ?
+			std::vector<uint32_t>{ truetype::TAG_MAXP, truetype::TAG_HHEA, truetype::TAG_HEAD, truetype::TAG_HMTX, truetype::TAG_CMAP, truetype::TAG_CFF } :
+			std::vector<uint32_t>{ truetype::TAG_MAXP, truetype::TAG_HHEA, truetype::TAG_HEAD, truetype::TAG_HMTX, truetype::TAG_LOCA, truetype::TAG_CMAP, truetype::TAG_GLYF };
+		for (uint32_t tag : required_tables)
+		{
+			const tou::truetype::table_record* record = m_find_table(tag);
+			if (record == nullptr)
+			{
+				LOG("The font file is missing the required '" << truetype::tag_to_string(tag) << "' table");
+				return false;
+			}
+			if ((uint64_t)record->offset + (uint64_t)record->length > m_data->reader.size())
+			{
+				LOG("The '" << truetype::tag_to_string(tag) << "' table extends past the end of the font file");
+				return false;
+			}
+			if (tag != truetype::TAG_GLYF && tag != truetype::TAG_CFF)
+				m_data->reader.pin(record->offset, record->length);
+		}
+
+		// resolve the tables used while decoding glyphs once
+		if (!cff_outlines)
+		{
+			m_data->glyf_table = *m_find_table(truetype::TAG_GLYF);
+			m_data->loca_table = *m_find_table(truetype::TAG_LOCA);
+		}
+		m_data->hmtx_table = *m_find_table(truetype::TAG_HMTX);
+		m_data->cmap_table = *m_find_table(truetype::TAG_CMAP);
+
+		// get number of glyphs in font file
+		m_data->reader.set_position(m_find_table(truetype::TAG_MAXP)->offset);
+		tou::truetype::maxp maxp;
+		maxp.version = m_data->reader.get_uint32();
+		if (maxp.version == 0x00010000)
+		{
+			m_data->num_glyphs = m_data->reader.get_uint16();
+			//24
+			m_data->reader.increment_position(24);
+			maxp.max_component_depth = m_data->reader.get_uint16();
+			m_data->max_component_depth = maxp.max_component_depth;
+		}
+		else if (maxp.version == 0x00005000 && cff_outlines)
+		{
+			// version 0.5 only holds the glyph count, the rest describes TrueType instructions
+			m_data->num_glyphs = m_data->reader.get_uint16();
+		}
+		else
+		{
+			LOG("maxp version unsupported or not defined");
+			return false;
+		}
+
+		// get number of horizontal metrics, neccessary for parsing hmtx table
+		m_data->reader.set_position(m_find_table(truetype::TAG_HHEA)->offset);
+		m_data->reader.increment_position(34);
+		m_data->num_hori_metrics = m_data->reader.get_uint16();
+		if (m_data->num_hori_metrics == 0)
+		{
+			LOG("hhea defines no horizontal metrics!");
+			return false;
+		}
+
+		// get units per em and the index to location format from the head table
+		m_data->reader.set_position(m_find_table(truetype::TAG_HEAD)->offset);
+		m_data->reader.increment_position(18);
+		m_data->units_per_em = m_data->reader.get_uint16();
+		m_data->reader.increment_position(30);
+		m_data->index_to_loc_format = m_data->reader.get_int16();
+
+		if (!cff_outlines && m_data->index_to_loc_format != 0 && m_data->index_to_loc_format != 1)
+		{
+			LOG("Invalid index to Location Format!");
+			return false;
+		}
+
+		// charstrings are run straight from the CFF table, only the INDEX offsets and subroutine lists are decoded up front
+		if (cff_outlines && !m_parse_cff())
+			return false;
+		if (!cff_outlines)
+			m_parse_variations();
+		m_parse_bitmap_strikes();
+
+		if (m_data->options.lazy_tables)
+		{
+			// hmtx and loca entries are read from the font file when a glyph needs them, cmap is parsed on the first lookup
+			return true;
+		}
+
+		m_parse_hmtx();
+		if (!cff_outlines)
+			m_parse_loca();
+		if (!m_parse_cmap())
+			return false;
+
+		// the sidecar format has no room for CFF data, those faces are always parsed from the font file
+		if (!m_data->options.cache_directory.empty() && !cff_outlines)
+			m_write_sidecar(filepath);
+		return true;
+	}
+
+	bool font_face::m_validate_tables()
+	{
+		for (const truetype::table_record& record : m_data->table_records)
+		{
+			if ((uint64_t)record.offset + (uint64_t)record.length > m_data->reader.size())
+			{
+				LOG("The '" << truetype::tag_to_string(record.tag) << "' table extends past the end of the font file");
+				return false;
+			}
+
+			// summed in chunks so partial mode never needs a whole table in memory at once
+			constexpr uint64_t chunk_words = 16 * 1024;
+			uint64_t words = record.length / 4;
+			uint32_t sum = 0;
+			for (uint64_t w = 0; w < words; w += chunk_words)
+			{
+				size_t n = static_cast<size_t>(std::min(chunk_words, words - w));
+				sum += tou::big_endian_sum32(m_data->reader.get_bytes((uint64_t)record.offset + w * 4, n * 4), n);
+			}
+
+			// the last word is zero padded, the padding itself may be missing from the file
+			uint32_t tail = record.length % 4;
+			if (tail != 0)
+			{
+				char padded[4] = { 0, 0, 0, 0 };
+				std::memcpy(padded, m_data->reader.get_bytes((uint64_t)record.offset + words * 4, tail), tail);
+				sum += tou::big_endian_sum32(padded, 1);
+			}
+
+			// head.checksum_adjustment is computed after the table checksum, so it is treated as zero
+			if (record.tag == truetype::TAG_HEAD && record.length >= 12)
+			{
+				const char* b = m_data->reader.get_bytes((uint64_t)record.offset + 8, 4);
+				sum -= tou::join_bytes({ b[0], b[1], b[2], b[3] });
+			}
+
+			if (sum != record.checksum)
+			{
+				LOG("The checksum of the '" << truetype::tag_to_string(record.tag) << "' table does not match, the font file is corrupted");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template <typename T>
+	std::shared_ptr<const T> font_face::m_decode_table(const truetype::table_record& record, uint32_t variant, const std::function<T()>& decode)
+	{
+		if (!m_data->shared_tables)
+			return std::make_shared<const T>(decode());
+
+		// faces of a collection pointing at the same table decode it once
+		// 'variant' holds whatever else the decoded result depends on (glyph count, loca format...)
+		font_collection::shared_tables::key k{ record.tag, record.offset, record.length, variant };
+		return std::static_pointer_cast<const T>(m_data->shared_tables->get(k, [&decode]() -> std::shared_ptr<const void> { return std::make_shared<const T>(decode()); }));
+	}
+
+	void font_face::m_parse_hmtx()
+	{
+		m_data->hmtx = m_decode_table<truetype::hmtx>(m_data->hmtx_table, m_data->num_hori_metrics, [this]()
+		{
+			truetype::hmtx hmtx;
+			m_data->reader.set_position(m_data->hmtx_table.offset);
+
+			// each long_hor_metric is an advance width followed by a left side bearing, decoded in place
+			hmtx.hmetrics.resize(m_data->num_hori_metrics);
+			m_data->reader.read_be_u16_array(reinterpret_cast<uint16_t*>(hmtx.hmetrics.data()), hmtx.hmetrics.size() * 2);
+			return hmtx;
+		});
+
+		m_data->hmetrics = m_data->hmtx->hmetrics;
+	}
+
+	void font_face::m_parse_loca()
+	{
+		m_data->loca = m_decode_table<truetype::loca>(m_data->loca_table, ((uint32_t)m_data->num_glyphs << 1) | (uint32_t)m_data->index_to_loc_format, [this]()
+		{
+			truetype::loca loca;
+			m_data->reader.set_position(m_data->loca_table.offset);
+			size_t n = ((size_t)m_data->num_glyphs) + 1;
+			if (m_data->index_to_loc_format == 0)
+			{
+				loca.short_offsets.resize(n);
+				m_data->reader.read_be_u16_array(loca.short_offsets.data(), n);
+			}
+			else
+			{
+				loca.long_offsets.resize(n);
+				m_data->reader.read_be_u32_array(loca.long_offsets.data(), n);
+			}
+			return loca;
+		});
+
+		m_data->loca_short = m_data->loca->short_offsets;
+		m_data->loca_long = m_data->loca->long_offsets;
+	}
+
+	bool font_face::m_parse_cff()
+	{
+		const truetype::table_record& record = *m_find_table(truetype::TAG_CFF);
+		bool parsed = true;
+		m_data->cff = m_decode_table<cff::font>(record, m_data->num_glyphs, [this, &record, &parsed]()
+		{
+			cff::font font;
+			parsed = cff::parse_font(m_data->reader, record.offset, record.length, m_data->num_glyphs, font);
+			return font;
+		});
+
+		// a collection may have decoded this table for another face already
+		if (!parsed || m_data->cff->charstrings.count() == 0)
+		{
+			LOG("The 'CFF ' table is malformed or uses an unsupported format");
+			return false;
+		}
+
+		// in partial mode subroutines stay resident as nearly every charstring calls into them, charstrings go through the page cache
+		const cff::index& global_subrs = m_data->cff->global_subrs;
+		if (global_subrs.count() != 0)
+			m_data->reader.pin(global_subrs.offsets.front(), global_subrs.offsets.back() - global_subrs.offsets.front());
+		for (const cff::index& local_subrs : m_data->cff->local_subrs)
+			if (local_subrs.count() != 0)
+				m_data->reader.pin(local_subrs.offsets.front(), local_subrs.offsets.back() - local_subrs.offsets.front());
+		return true;
+	}
+
+	void font_face::m_parse_variations()
+	{
+		// fonts without both fvar and gvar are static, a variations table that is present but malformed leaves only the default instance
+		const truetype::table_record* fvar = m_find_table(truetype::TAG_FVAR);
+		const truetype::table_record* gvar = m_find_table(truetype::TAG_GVAR);
+		const truetype::table_record* avar = m_find_table(truetype::TAG_AVAR);
+		if (fvar == nullptr || gvar == nullptr)
+			return;
+		for (const truetype::table_record* record : { fvar, gvar, avar })
+		{
+			if (record != nullptr && (uint64_t)record->offset + (uint64_t)record->length > m_data->reader.size())
+			{
+				LOG("The '" << truetype::tag_to_string(record->tag) << "' table extends past the end of the font file");
+				return;
+			}
+		}
+
+		auto span = [](const truetype::table_record* record)
+		{
+			return record ? tou::variations::table_span{ record->offset, record->length } : tou::variations::table_span{};
+		};
+		bool parsed = true;
+		std::shared_ptr<const tou::variations::font> decoded = m_decode_table<tou::variations::font>(*gvar, m_data->num_glyphs, [&]()
+		{
+			tou::variations::font font;
+			parsed = tou::variations::parse_font(m_data->reader, span(fvar), span(avar), span(gvar), m_data->num_glyphs, font);
+			return font;
+		});
+
+		// a collection may have decoded this table for another face already
+		if (!parsed || decoded->glyph_data.empty())
+		{
+			LOG("The font variation tables are malformed, only the default instance is available");
+			return;
+		}
+		m_data->variations = decoded;
+	}
+
+	void font_face::m_parse_bitmap_strikes()
+	{
+		// embedded bitmaps are optional, the glyphs of a font whose strikes can't be read are rasterized from their outlines
+		const truetype::table_record* eblc = m_find_table(truetype::TAG_EBLC);
+		const truetype::table_record* ebdt = m_find_table(truetype::TAG_EBDT);
+		if (eblc == nullptr || ebdt == nullptr)
+			return;
+		for (const truetype::table_record* record : { eblc, ebdt })
+		{
+			if ((uint64_t)record->offset + (uint64_t)record->length > m_data->reader.size())
+			{
+				LOG("The '" << truetype::tag_to_string(record->tag) << "' table extends past the end of the font file");
+				return;
+			}
+		}
+
+		bool parsed = true;
+		std::shared_ptr<const tou::sbit::font> decoded = m_decode_table<tou::sbit::font>(*eblc, m_data->num_glyphs, [&]()
+		{
+			tou::sbit::font font;
+			parsed = tou::sbit::parse_font(m_data->reader, eblc->offset, eblc->length, ebdt->offset, ebdt->length, m_data->num_glyphs, font);
+			return font;
+		});
+
+		// a collection may have decoded this table for another face already
+		if (!parsed || decoded->data_length == 0)
+		{
+			LOG("The embedded bitmap tables are malformed, every glyph will be rasterized");
+			return;
+		}
+		if (decoded->strikes.empty())
+			return;
+
+		// index subtables are read on every bitmap lookup, EBDT goes through the page cache like glyf
+		m_data->reader.pin(eblc->offset, eblc->length);
+		m_data->bitmap_strikes = decoded;
+	}
+
+	bool font_face::m_parse_cmap()
+	{
+		m_data->cmap = m_decode_table<font_face::parsed_cmap>(m_data->cmap_table, 0, [this]()
+		{
+			// in lazy mode this runs while other threads copy m_data->reader, so it reads through its own cursor
+			tou::vector_reader reader = m_data->reader;
+			font_face::parsed_cmap cmap;
+			reader.set_position(m_data->cmap_table.offset);
+			// first is cmap head
+			cmap.header.version =		reader.get_uint16();
+			cmap.header.num_tables =	reader.get_uint16();
+			for (uint64_t i = 0; i < cmap.header.num_tables; i++)
+			{
+				tou::truetype::cmap_encoding encoding;
+				encoding.platform_id =	reader.get_uint16();
+				encoding.encoding_id =	reader.get_uint16();
+				encoding.offset =		reader.get_uint32();
+				cmap.header.encoding_records.push_back(encoding);
+			}
+			for (auto& encoding_record : cmap.header.encoding_records)
+			{
+				reader.set_position((uint64_t)m_data->cmap_table.offset + (uint64_t)encoding_record.offset);
+				if ((encoding_record.platform_id == 3) && (encoding_record.encoding_id == 1))
+				{
+					// Unicode BMP font with data stored using cmap subtable format 4
+					cmap.format4_exists = true;
+					tou::truetype::cmap_format4& format = cmap.format4;
+					//format.format =			reader.get_uint16();
+					//format.length =			reader.get_uint16();
+					//format.language =			reader.get_uint16();
+					reader.increment_position(6);
+					format.seg_count_x2 =	reader.get_uint16();
+					//format.search_range =		reader.get_uint16();
+					//format.entry_selector =	reader.get_uint16();
+					//format.range_shift =		reader.get_uint16();
+					reader.increment_position(6);
+
+					uint16_t seg_count = format.seg_count_x2 / 2;
+					format.end_code.resize(seg_count);
+					format.start_code.resize(seg_count);
+					format.id_delta.resize(seg_count);
+					format.id_range_offset.resize(seg_count);
+
+					reader.read_be_u16_array(format.end_code.data(), seg_count);
+
+					//format.reserved_pad = reader.get_uint16();
+					reader.increment_position(2);
+
+					reader.read_be_u16_array(format.start_code.data(), seg_count);
+					reader.read_be_u16_array(reinterpret_cast<uint16_t*>(format.id_delta.data()), seg_count);
+
+					cmap.id_range_offset_from_filestart = reader.get_position();
+
+					reader.read_be_u16_array(format.id_range_offset.data(), seg_count);
+				}
+			}
+			return cmap;
+		});
+
+		m_data->seg_count = m_data->cmap->format4.seg_count_x2 / 2;
+		m_data->id_range_offset_from_filestart = m_data->cmap->id_range_offset_from_filestart;
+		m_data->cmap_lookup.end_code = m_data->cmap->format4.end_code;
+		m_data->cmap_lookup.start_code = m_data->cmap->format4.start_code;
+		m_data->cmap_lookup.id_delta = m_data->cmap->format4.id_delta;
+		m_data->cmap_lookup.id_range_offset = m_data->cmap->format4.id_range_offset;
+		m_finish_cmap();
+		m_data->cmap_parsed.store(true, std::memory_order_release);
+
+		if (!m_data->cmap->format4_exists && !m_data->cmap_pages_table)
+		{
+			LOG("Neither a cmap subtable format 4 nor a full Unicode subtable (format 12 or 13) could be found in the font file");
+			return false;
+		}
+		return true;
+	}
+
+	void font_face::m_finish_cmap()
+	{
+		m_parse_cmap_groups();
+		if (m_data->options.dense_cmap && !m_data->cmap_pages_table)
+			m_expand_cmap();
+
+		// Latin-1 is looked up often enough to always get a table of its own
+		tou::vector_reader reader = m_data->reader;
+		for (uint32_t c = 0; c < 256; c++)
+			m_data->latin1_glyph_ids[c] = m_find_glyph_id(reader, c);
+	}
+
+	void font_face::m_parse_cmap_groups()
+	{
+		// the full Unicode subtable, the Windows one is preferred
+		tou::vector_reader reader = m_data->reader;
+		const uint64_t cmap_end = (uint64_t)m_data->cmap_table.offset + m_data->cmap_table.length;
+		reader.set_position((uint64_t)m_data->cmap_table.offset + 2);
+		uint16_t num_tables = reader.get_uint16();
+		if ((uint64_t)m_data->cmap_table.offset + 4 + (uint64_t)num_tables * 8 > cmap_end)
+			return;
+
+		uint64_t subtable = 0;
+		int best_rank = 3;
+		for (uint16_t i = 0; i < num_tables; i++)
+		{
+			reader.set_position((uint64_t)m_data->cmap_table.offset + 4 + (uint64_t)i * 8);
+			uint16_t platform_id = reader.get_uint16();
+			uint16_t encoding_id = reader.get_uint16();
+			uint64_t offset = (uint64_t)m_data->cmap_table.offset + reader.get_uint32();
+			int rank = (platform_id == 3 && encoding_id == 10) ? 0 : (platform_id == 0 && encoding_id == 4) ? 1 : (platform_id == 0 && encoding_id == 6) ? 2 : 3;
+			if (rank >= best_rank || offset + 16 > cmap_end)
+				continue;
+			reader.set_position(offset);
+			uint16_t format = reader.get_uint16();
+			if (format == 12 || format == 13)
+			{
+				subtable = offset;
+				best_rank = rank;
+			}
+		}
+		if (subtable == 0)
+			return;
+
+		m_data->cmap_pages_table = m_decode_table<font_face::cmap_page_table>(m_data->cmap_table, ((uint32_t)m_data->num_glyphs << 2) | 2, [&]()
+		{
+			font_face::cmap_page_table table;
+			table.pages.resize(0x1100, 0);
+			table.glyph_ids.resize(256, 0);
+
+			reader.set_position(subtable);
+			const bool many_to_one = reader.get_uint16() == 13;
+			reader.set_position(subtable + 12);
+			uint32_t num_groups = reader.get_uint32();
+			if (subtable + 16 + (uint64_t)num_groups * 12 > cmap_end)
+			{
+				LOG("The full Unicode cmap subtable extends past the end of the cmap table");
+				return table;
+			}
+			std::vector<uint32_t> groups((size_t)num_groups * 3);
+			reader.read_be_u32_array(groups.data(), groups.size());
+
+			// groups are sorted by start code and don't overlap, a group starting before the end of an earlier one is clipped to what
+			// follows it, so every codepoint is written at most once and a malformed table costs no more than a full one
+			// format 13 fonts (last resort fonts) map whole planes to a few glyphs, pages filled with one glyph are shared
+			std::map<uint16_t, uint16_t> uniform_pages;
+			uint32_t next = 0; // first codepoint after the groups read so far
+			bool malformed = false;
+			for (uint32_t i = 0; i < num_groups; i++)
+			{
+				const uint32_t start_code = groups[i * 3], start_glyph = groups[i * 3 + 2];
+				uint64_t start = std::max(start_code, next), end = std::min<uint32_t>(groups[i * 3 + 1], 0x10FFFF);
+				if (start != start_code || end != groups[i * 3 + 1])
+					malformed = true;
+				if (start > end)
+					continue;
+				next = static_cast<uint32_t>(end + 1);
+
+				// format 12 maps a group onto consecutive glyphs, format 13 maps the whole group to one glyph
+				// glyph 0 and glyph ids past maxp are left unmapped
+				if (start_glyph >= m_data->num_glyphs || (many_to_one && start_glyph == 0))
+					continue;
+				if (!many_to_one)
+				{
+					end = std::min<uint64_t>(end, (uint64_t)start_code + (m_data->num_glyphs - 1 - start_glyph));
+					if (start == start_code && start_glyph == 0)
+						start++;
+				}
+
+				for (uint64_t low = start; low <= end; low = (low | 0xff) + 1)
+				{
+					const uint64_t high = std::min<uint64_t>(end, low | 0xff);
+					uint16_t& page = table.pages[low >> 8];
+					if (many_to_one && page == 0 && (low & 0xff) == 0 && (high & 0xff) == 0xff)
+					{
+						auto it = uniform_pages.find(static_cast<uint16_t>(start_glyph));
+						if (it == uniform_pages.end())
+						{
+							it = uniform_pages.emplace(static_cast<uint16_t>(start_glyph), static_cast<uint16_t>(table.glyph_ids.size() / 256)).first;
+							table.glyph_ids.resize(table.glyph_ids.size() + 256, static_cast<uint16_t>(start_glyph));
+						}
+						page = it->second;
+						continue;
+					}
+					if (page == 0)
+					{
+						page = static_cast<uint16_t>(table.glyph_ids.size() / 256);
+						table.glyph_ids.resize(table.glyph_ids.size() + 256, 0);
+					}
+					uint16_t* slots = table.glyph_ids.data() + (size_t)page * 256;
+					for (uint64_t c = low; c <= high; c++)
+						slots[c & 0xff] = static_cast<uint16_t>(many_to_one ? start_glyph : start_glyph + (c - start_code));
+				}
+			}
+			if (malformed)
+				LOG("The full Unicode cmap has overlapping or out of range groups, they were clipped");
+			return table;
+		});
+
+		// a table without any mapped codepoint (malformed, or only glyph ids past maxp) leaves the format 4 lookup in place
+		if (m_data->cmap_pages_table->glyph_ids.size() == 256)
+		{
+			m_data->cmap_pages_table.reset();
+			return;
+		}
+		m_data->cmap_pages = m_data->cmap_pages_table->pages;
+		m_data->cmap_page_glyph_ids = m_data->cmap_pages_table->glyph_ids;
+	}
+
+	void font_face::m_expand_cmap()
+	{
+		m_data->bmp_glyph_table = m_decode_table<std::vector<uint16_t>>(m_data->cmap_table, 1, [this]()
+		{
+			// each segment is walked once, codepoints an earlier segment already ends after belong to that one, as in the search
+			tou::vector_reader reader = m_data->reader;
+			std::vector<uint16_t> glyph_ids(65536, 0);
+			uint32_t next = 0;
+			for (uint64_t i = 0; i < m_data->seg_count; i++)
+			{
+				for (uint32_t c = std::max<uint32_t>(next, m_data->cmap_lookup.start_code[i]); c <= m_data->cmap_lookup.end_code[i]; c++)
+					glyph_ids[c] = m_get_format4_glyph_id(reader, i, static_cast<uint16_t>(c));
+				next = std::max<uint32_t>(next, (uint32_t)m_data->cmap_lookup.end_code[i] + 1);
+			}
+			return glyph_ids;
+		});
+		m_data->bmp_glyph_ids = *m_data->bmp_glyph_table;
+	}
+
+	// sidecar files hold the parsed table directory, loca, hmtx and cmap format 4 arrays of a font
+	// everything is stored in native byte order and each array starts on an 8 byte boundary so it can be used straight from the mapping
+	constexpr uint32_t SIDECAR_MAGIC = 0x43534646; // "FFSC"
+	constexpr uint32_t SIDECAR_VERSION = 3;
+
+	struct sidecar_header
+	{
+		uint32_t magic = SIDECAR_MAGIC;
+		uint32_t version = SIDECAR_VERSION;
+		uint64_t font_size = 0;
+		int64_t font_mtime = 0;
+		uint32_t path_length = 0;
+		uint32_t num_tables = 0;
+		uint32_t num_loca = 0; // uint16_t entries for short loca, uint32_t for long
+		uint32_t num_hmetrics = 0;
+		uint16_t num_glyphs = 0, num_hori_metrics = 0, units_per_em = 0;
+		int16_t index_to_loc_format = 0;
+		uint16_t seg_count = 0, max_component_depth = 0;
+		uint64_t id_range_offset_from_filestart = 0;
+	};
+
+	static_assert(sizeof(truetype::table_record) == 16 && sizeof(truetype::long_hor_metric) == 4, "sidecar arrays are stored with their in-memory layout");
+
+	size_t align_sidecar_offset(size_t x)
+	{
+		return (x + 7) & ~static_cast<size_t>(7);
+	}
+
+	std::string font_face::m_sidecar_path(const std::string& absolute_path) const
+	{
+		// 64-bit FNV-1a, stable across builds unlike std::hash
+		uint64_t hash = 0xcbf29ce484222325;
+		for (char c : absolute_path)
+		{
+			hash ^= static_cast<uint8_t>(c);
+			hash *= 0x100000001b3;
+		}
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.ffcache", static_cast<unsigned long long>(hash));
+		return (std::filesystem::path(m_data->options.cache_directory) / name).string();
+	}
+
+	bool font_face::m_load_sidecar(const std::string& filepath)
+	{
+		std::string absolute_path;
+		uint64_t font_size = 0;
+		int64_t font_mtime = 0;
+		if (!get_font_file_key(filepath, absolute_path, m_data->options.face_index, font_size, font_mtime))
+			return false;
+
+		std::error_code ec;
+		std::string path = m_sidecar_path(absolute_path);
+		if (!std::filesystem::is_regular_file(path, ec))
+			return false;
+
+		std::shared_ptr<tou::file_mapping> sidecar = std::make_shared<tou::file_mapping>();
+		if (!sidecar->open(path) || sidecar->size() < sizeof(sidecar_header))
+			return false;
+
+		sidecar_header header;
+		std::memcpy(&header, sidecar->data(), sizeof(header));
+		if (header.magic != SIDECAR_MAGIC || header.version != SIDECAR_VERSION || header.font_size != font_size || header.font_mtime != font_mtime)
+			return false;
+
+		// walks the sections in the order they were written, fails if one runs past the end of the sidecar
+		size_t offset = align_sidecar_offset(sizeof(sidecar_header));
+		bool truncated = false;
+		auto section = [&](size_t bytes) -> const char*
+		{
+			if (truncated || offset + bytes > sidecar->size())
+			{
+				truncated = true;
+				return nullptr;
+			}
+			const char* p = sidecar->data() + offset;
+			offset = align_sidecar_offset(offset + bytes);
+			return p;
+		};
+
+		const char* stored_path = section(header.path_length);
+		if (truncated || std::string(stored_path, header.path_length) != absolute_path)
+			return false; // hash collision with another font
+
+		const char* tables = section(sizeof(truetype::table_record) * header.num_tables);
+		size_t loca_entry_size = (header.index_to_loc_format == 0) ? sizeof(uint16_t) : sizeof(uint32_t);
+		const char* loca = section(loca_entry_size * header.num_loca);
+		const char* hmetrics = section(sizeof(truetype::long_hor_metric) * header.num_hmetrics);
+		const char* end_code = section(sizeof(uint16_t) * header.seg_count);
+		const char* start_code = section(sizeof(uint16_t) * header.seg_count);
+		const char* id_delta = section(sizeof(int16_t) * header.seg_count);
+		const char* id_range_offset = section(sizeof(uint16_t) * header.seg_count);
+		if (truncated)
+			return false;
+
+		// a sidecar whose key still matches can be stale or corrupt, everything is checked before m_data is touched so a
+		// rejected one leaves nothing behind for the full parse, which builds the same arrays the lookups index by glyph id
+		if ((header.index_to_loc_format != 0 && header.index_to_loc_format != 1) || header.num_loca != (uint32_t)header.num_glyphs + 1 ||
+			header.num_hori_metrics == 0 || header.num_hmetrics != header.num_hori_metrics)
+			return false;
+		const truetype::table_record* records = reinterpret_cast<const truetype::table_record*>(tables);
+		const truetype::table_record* records_end = records + header.num_tables;
+		if (!std::is_sorted(records, records_end, [](const truetype::table_record& a, const truetype::table_record& b) { return a.tag < b.tag; }))
+			return false;
+		for (uint32_t tag : { truetype::TAG_HMTX, truetype::TAG_LOCA, truetype::TAG_CMAP, truetype::TAG_GLYF })
+		{
+			const truetype::table_record* record = std::lower_bound(records, records_end, tag,
+				[](const truetype::table_record& r, uint32_t t) { return r.tag < t; });
+			if (record == records_end || record->tag != tag || (uint64_t)record->offset + (uint64_t)record->length > font_size)
+				return false;
+		}
+
+		m_data->table_records.assign(records, records_end);
+		m_data->glyf_table = *m_find_table(truetype::TAG_GLYF);
+		m_data->loca_table = *m_find_table(truetype::TAG_LOCA);
+		m_data->hmtx_table = *m_find_table(truetype::TAG_HMTX);
+		m_data->cmap_table = *m_find_table(truetype::TAG_CMAP);
+
+		m_data->num_glyphs = header.num_glyphs;
+		m_data->num_hori_metrics = header.num_hori_metrics;
+		m_data->units_per_em = header.units_per_em;
+		m_data->index_to_loc_format = header.index_to_loc_format;
+		m_data->seg_count = header.seg_count;
+		m_data->max_component_depth = header.max_component_depth;
+		m_data->id_range_offset_from_filestart = header.id_range_offset_from_filestart;
+
+		if (header.index_to_loc_format == 0)
+			m_data->loca_short = { reinterpret_cast<const uint16_t*>(loca), header.num_loca };
+		else
+			m_data->loca_long = { reinterpret_cast<const uint32_t*>(loca), header.num_loca };
+		m_data->hmetrics = { reinterpret_cast<const truetype::long_hor_metric*>(hmetrics), header.num_hmetrics };
+		m_data->cmap_lookup.end_code = { reinterpret_cast<const uint16_t*>(end_code), header.seg_count };
+		m_data->cmap_lookup.start_code = { reinterpret_cast<const uint16_t*>(start_code), header.seg_count };
+		m_data->cmap_lookup.id_delta = { reinterpret_cast<const int16_t*>(id_delta), header.seg_count };
+		m_data->cmap_lookup.id_range_offset = { reinterpret_cast<const uint16_t*>(id_range_offset), header.seg_count };
+		m_data->cmap_parsed.store(true, std::memory_order_release);
+
+		m_data->sidecar = sidecar; // the views above point into the mapping
+		return true;
+	}
+
+	void font_face::m_write_sidecar(const std::string& filepath) const
+	{
+		sidecar_header header;
+		std::string absolute_path;
+		if (!get_font_file_key(filepath, absolute_path, m_data->options.face_index, header.font_size, header.font_mtime))
+			return;
+
+		header.path_length = static_cast<uint32_t>(absolute_path.size());
+		header.num_tables = static_cast<uint32_t>(m_data->table_records.size());
+		header.num_loca = static_cast<uint32_t>(m_data->loca_short.size + m_data->loca_long.size);
+		header.num_hmetrics = static_cast<uint32_t>(m_data->hmetrics.size);
+		header.num_glyphs = m_data->num_glyphs;
+		header.num_hori_metrics = m_data->num_hori_metrics;
+		header.units_per_em = m_data->units_per_em;
+		header.index_to_loc_format = m_data->index_to_loc_format;
+		header.seg_count = m_data->seg_count;
+		header.max_component_depth = m_data->max_component_depth;
+		header.id_range_offset_from_filestart = m_data->id_range_offset_from_filestart;
+
+		std::vector<char> bytes;
+		auto append = [&bytes](const void* data, size_t n)
+		{
+			size_t at = bytes.size();
+			bytes.resize(align_sidecar_offset(at + n), 0);
+			if (n != 0)
+				std::memcpy(bytes.data() + at, data, n);
+		};
+		append(&header, sizeof(header));
+		append(absolute_path.data(), absolute_path.size());
+		append(m_data->table_records.data(), sizeof(truetype::table_record) * m_data->table_records.size());
+		append(m_data->loca_short.data, sizeof(uint16_t) * m_data->loca_short.size);
+		append(m_data->loca_long.data, sizeof(uint32_t) * m_data->loca_long.size);
+		append(m_data->hmetrics.data, sizeof(truetype::long_hor_metric) * m_data->hmetrics.size);
+		append(m_data->cmap_lookup.end_code.data, sizeof(uint16_t) * m_data->seg_count);
+		append(m_data->cmap_lookup.start_code.data, sizeof(uint16_t) * m_data->seg_count);
+		append(m_data->cmap_lookup.id_delta.data, sizeof(int16_t) * m_data->seg_count);
+		append(m_data->cmap_lookup.id_range_offset.data, sizeof(uint16_t) * m_data->seg_count);
+
+		// write to a temporary file first so concurrent loads never map a partially written sidecar
+		std::error_code ec;
+		std::filesystem::create_directories(m_data->options.cache_directory, ec);
+		std::string path = m_sidecar_path(absolute_path);
+		std::string temp_path = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+		std::ofstream out(temp_path, std::ios::binary | std::ios::out | std::ios::trunc);
+		if (!out)
+		{
+			LOG("Failed to write font cache file " << temp_path);
+			return;
+		}
+		out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+		out.close();
+		std::filesystem::rename(temp_path, path, ec);
+		if (ec)
+		{
+			std::filesystem::remove(temp_path, ec);
+			LOG("Failed to write font cache file " << path);
+		}
+	}
+
+	const truetype::table_record* font_face::m_find_table(uint32_t tag) const
+	{
+		auto it = std::lower_bound(m_data->table_records.begin(), m_data->table_records.end(), tag,
+			[](const truetype::table_record& record, uint32_t t) { return record.tag < t; });
+		if (it == m_data->table_records.end() || it->tag != tag)
+			return nullptr;
+		return &(*it);
+	}
+
+	void font_face::map_codepoints(const char32_t* codepoints, size_t count, uint16_t* glyph_ids)
 	{
-		if (m_glyphs.find(unicode) != m_glyphs.end())
-		{
-			return m_glyphs[unicode];
-		}
-		else
+		m_ensure_cmap_parsed();
+		tou::vector_reader reader = m_data->reader;
+		const uint16_t* latin1 = m_data->latin1_glyph_ids.data();
+
+		// without a page or dense table, ascending runs move a cursor through the format 4 segments instead of searching them again
+		const bool search_segments = m_data->cmap_pages.empty() && m_data->bmp_glyph_ids.empty();
+		const font_face::cmap_format4_lookup& cmap = m_data->cmap_lookup;
+		const uint64_t seg_count = m_data->seg_count;
+		uint64_t segment = 0;
+		char32_t previous = 0;
+
+		for (size_t n = 0; n < count; n++)
 		{
-			font_face::truetype_glyph glyph = m_get_truetype_glyph(unicode);
-			if (glyph.id != 0)
+			char32_t c = codepoints[n];
+			if (c < 256)
 			{
-				m_glyphs.insert({ unicode, glyph });
-				return m_glyphs[unicode];
+				glyph_ids[n] = latin1[c];
+				continue;
 			}
-			else
+			if (!search_segments || c > 0xFFFF)
 			{
-				LOG("The requested glyph could not be found in the font file");
-				if (m_glyphs.find(0) != m_glyphs.end())
-				{
-					return m_glyphs[0];
-				}
-				else
+				glyph_ids[n] = m_find_glyph_id(reader, c);
+				continue;
+			}
+
+			// a codepoint lower than the last one starts a new run with a plain search, ascending ones gallop from the cursor
+			// to the first segment ending at or after them so nearby codepoints only take a step or two
+			if (c < previous)
+				segment = std::lower_bound(cmap.end_code.data, cmap.end_code.data + seg_count, c) - cmap.end_code.data;
+			else if (segment < seg_count && cmap.end_code[segment] < c)
+			{
+				uint64_t step = 1;
+				while (segment + step < seg_count && cmap.end_code[segment + step] < c)
 				{
-					m_glyphs.insert({ 0, glyph });
-					return m_glyphs[0];
+					segment += step;
+					step *= 2;
 				}
+				uint64_t last = std::min(segment + step, seg_count);
+				segment = std::lower_bound(cmap.end_code.data + segment + 1, cmap.end_code.data + last, c) - cmap.end_code.data;
 			}
+			previous = c;
+
+			if (segment == seg_count || c < cmap.start_code[segment])
+				glyph_ids[n] = 0;
+			else
+				glyph_ids[n] = m_get_format4_glyph_id(reader, segment, static_cast<uint16_t>(c));
 		}
-		return m_glyphs[0];
 	}
 
-	font_face::bitmap_glyph font_face::get_glyph_bitmap(uint16_t unicode, float point_size, bool render_outline, bool render_inside)
+	bool font_face::has_glyph(uint32_t unicode)
 	{
-		font_face::truetype_glyph g = get_glyph(unicode);
+		const font_face::unicode_coverage& coverage = m_get_coverage();
+		if (unicode < 0x10000)
+			return (coverage.bmp_bits[unicode >> 6] >> (unicode & 63)) & 1;
 
-		if (g.id == 0) LOG("An empty glyph was returned as a bitmap");
-
-		return m_rasterize_truetype_glyph(g, point_size, render_outline, render_inside);
+		auto it = std::upper_bound(coverage.ranges.begin(), coverage.ranges.end(), unicode,
+			[](uint32_t c, const font_face::codepoint_range& range) { return c < range.first; });
+		return it != coverage.ranges.begin() && unicode <= (it - 1)->last;
 	}
 
-	bool font_face::m_parse_truetype_file(const std::string& filepath)
+	size_t font_face::count_covered(const char32_t* codepoints, size_t count)
 	{
-		if (!m_reader.load(filepath))
-			return false;
+		size_t covered = 0;
+		for (size_t n = 0; n < count; n++)
+			covered += has_glyph(codepoints[n]);
+		return covered;
+	}
 
-		tou::truetype::offset_table offset_table;
-		offset_table.sfnt_version = m_reader.get_uint32();
-		if (m_sfnt != offset_table.sfnt_version)
-		{
-			LOG("The sfnt version of this font file is unsupported");
-			return false;
-		}
+	const std::vector<font_face::codepoint_range>& font_face::get_coverage()
+	{
+		return m_get_coverage().ranges;
+	}
 
-		offset_table.num_tables =		m_reader.get_uint16();
-		offset_table.search_range =		m_reader.get_uint16();
-		offset_table.entry_selector =	m_reader.get_uint16();
-		offset_table.range_shift =		m_reader.get_uint16();
+	const font_face::unicode_coverage& font_face::m_get_coverage()
+	{
+		if (m_data->coverage_built.load(std::memory_order_acquire))
+			return *m_data->coverage;
 
-		m_table_records.reserve(offset_table.num_tables);
+		m_ensure_cmap_parsed();
+		std::lock_guard<std::mutex> lock(m_data->cmap_mutex);
+		if (m_data->coverage_built.load(std::memory_order_relaxed))
+			return *m_data->coverage;
 
-		for (int i = 0; i < offset_table.num_tables; i++)
+		// the page table depends on the glyph count, and so does everything derived from it
+		m_data->coverage = m_decode_table<font_face::unicode_coverage>(m_data->cmap_table, ((uint32_t)m_data->num_glyphs << 2) | 3, [this]()
 		{
-			if ((m_reader.get_array()[m_reader.get_position()] <= 0x7E     && m_reader.get_array()[m_reader.get_position()] >= 0x20) &&
-				(m_reader.get_array()[m_reader.get_position() + 1] <= 0x7E && m_reader.get_array()[m_reader.get_position() + 1] >= 0x20) &&
-				(m_reader.get_array()[m_reader.get_position() + 2] <= 0x7E && m_reader.get_array()[m_reader.get_position() + 2] >= 0x20) &&
-				(m_reader.get_array()[m_reader.get_position() + 3] <= 0x7E && m_reader.get_array()[m_reader.get_position() + 3] >= 0x20))
+			font_face::unicode_coverage coverage;
+			coverage.bmp_bits.resize(0x10000 / 64, 0);
+			auto add = [&coverage](uint32_t c)
 			{
-				tou::truetype::table_record record;
-				uint64_t p = m_reader.get_position();
+				if (c < 0x10000)
+					coverage.bmp_bits[c >> 6] |= uint64_t(1) << (c & 63);
+				if (!coverage.ranges.empty() && coverage.ranges.back().last + 1 == c)
+					coverage.ranges.back().last = c;
+				else
+					coverage.ranges.push_back({ c, c });
+			};
 
-				std::string table_name = std::string() + m_reader.get_array()[p] + m_reader.get_array()[p + 1] + m_reader.get_array()[p + 2] + m_reader.get_array()[p + 3];
-				record.tag =		m_reader.get_uint32();
-				record.checksum =	m_reader.get_uint32();
-				record.offset =		m_reader.get_uint32();
-				record.length =		m_reader.get_uint32();
-				
-				m_table_records.insert({ table_name, record });
-			}
-			else
+			if (!m_data->cmap_pages.empty())
 			{
-				LOG("The table record contains an invalid tag or the number of tables recorded in the offset table is incorrect.");
-				return false;
+				for (uint32_t page = 0; page < 0x1100; page++)
+				{
+					const size_t first = (size_t)m_data->cmap_pages[page] << 8;
+					if (first == 0)
+						continue;
+					for (uint32_t c = 0; c < 256; c++)
+						if (m_data->cmap_page_glyph_ids[first + c] != 0)
+							add((page << 8) | c);
+				}
+				return coverage;
 			}
-		}
-
-		// get number of glyphs in font file
-		m_reader.set_position(m_table_records["maxp"].offset);
-		tou::truetype::maxp maxp;
-		if (m_reader.get_uint32() == 0x00010000)
-		{
-			m_num_glyphs = m_reader.get_uint16();
-			//24
-			m_reader.increment_position(24);
-			maxp.max_component_depth = m_reader.get_uint16();
-		}
-		else
-		{
-			LOG("maxp version unsupported or not defined");
-			return false;
-		}
 
-		// get number of horizontal metrics, neccessary for parsing hmtx table
-		m_reader.set_position(m_table_records["hhea"].offset);
-		m_reader.increment_position(34);
-		uint16_t num_hori_metrics = m_reader.get_uint16();
-
-		// get units per em and the index to location format from the head table
-		m_reader.set_position(m_table_records["head"].offset);
-		m_reader.increment_position(18);
-		m_units_per_em = m_reader.get_uint16();
-		m_reader.increment_position(30);
-		int16_t index_to_loc_format = m_reader.get_int16();
-
-		// parse hmtx table
-		m_reader.set_position(m_table_records["hmtx"].offset);
-		if (m_num_glyphs < num_hori_metrics)
-		{
-			for (uint16_t i = 0; i < num_hori_metrics; i++)
-			{
-				uint16_t advance_width =	m_reader.get_uint16();
-				int16_t lsb =				m_reader.get_int16();
-				m_hmtx.hmetrics.push_back({ advance_width, lsb });
-			}
-		}
-		else if (m_num_glyphs >= num_hori_metrics)
-		{
-			for (uint16_t i = 0; i < num_hori_metrics; i++)
+			// lookups take the first segment ending at or after a codepoint, so overlapping segments only add what lies past the previous end
+			// glyph ids past maxp draw .notdef and are left out, as the format 12/13 page table does
+			tou::vector_reader reader = m_data->reader;
+			const font_face::cmap_format4_lookup& cmap = m_data->cmap_lookup;
+			uint32_t next = 0;
+			for (uint64_t i = 0; i < m_data->seg_count; i++)
 			{
-				uint16_t advance_width =	m_reader.get_uint16();
-				int16_t lsb =				m_reader.get_int16();
-				m_hmtx.hmetrics.push_back({ advance_width, lsb });
+				for (uint32_t c = std::max<uint32_t>(cmap.start_code[i], next); c <= cmap.end_code[i]; c++)
+				{
+					const uint16_t glyph_id = m_get_format4_glyph_id(reader, i, static_cast<uint16_t>(c));
+					if (glyph_id != 0 && glyph_id < m_data->num_glyphs)
+						add(c);
+				}
+				next = std::max<uint32_t>(next, (uint32_t)cmap.end_code[i] + 1);
 			}
-			for (uint16_t i = 0; i < static_cast<uint16_t>(m_num_glyphs - num_hori_metrics); i++)
-				m_hmtx.hmetrics.push_back({ m_hmtx.hmetrics[static_cast<size_t>(num_hori_metrics) - 1 + i].advance_width, m_hmtx.hmetrics[static_cast<size_t>(num_hori_metrics) - 1 + i].lsb });
-		}
+			return coverage;
+		});
+		m_data->coverage_built.store(true, std::memory_order_release);
+		return *m_data->coverage;
+	}
 
-		// parse loca table
-		m_reader.set_position(m_table_records["loca"].offset);
-		if (index_to_loc_format == 0)
-		{
-			uint64_t n = ((uint64_t)m_num_glyphs) + 1;
-			for (uint64_t i = 0; i < n; i++)
-				m_loca_offset32.push_back(((uint32_t)m_reader.get_uint16()) * 2);
-		}
-		else if (index_to_loc_format == 1)
-		{
-			uint64_t n = ((uint64_t)m_num_glyphs) + 1;
-			for (uint64_t i = 0; i < n; i++)
-				m_loca_offset32.push_back(m_reader.get_uint32());
-		}
-		else
+	void font_face::m_ensure_cmap_parsed()
+	{
+		if (!m_data->cmap_parsed.load(std::memory_order_acquire))
 		{
-			LOG("Invalid index to Location Format!");
-			return false;
+			// lazy mode, the first lookup parses cmap and concurrent lookups wait for it
+			std::lock_guard<std::mutex> lock(m_data->cmap_mutex);
+			if (!m_data->cmap_parsed.load(std::memory_order_relaxed))
+				m_parse_cmap();
 		}
+	}
 
-		// parse cmap table
-		m_reader.set_position(m_table_records["cmap"].offset);
-		// first is cmap head
-		m_cmap.first.version =		m_reader.get_uint16();
-		m_cmap.first.num_tables =	m_reader.get_uint16();
-		for (uint64_t i = 0; i < m_cmap.first.num_tables; i++)
-		{
-			tou::truetype::cmap_encoding encoding;
-			encoding.platform_id =	m_reader.get_uint16();
-			encoding.encoding_id =	m_reader.get_uint16();
-			encoding.offset =		m_reader.get_uint32();
-			m_cmap.first.encoding_records.push_back(encoding);
-		}
-		bool format4_exists = false;
-		for (auto& encoding_record : m_cmap.first.encoding_records)
-		{
-			m_reader.set_position((uint64_t)m_table_records["cmap"].offset + (uint64_t)encoding_record.offset);
-			if ((encoding_record.platform_id == 3) && (encoding_record.encoding_id == 1))
-			{
-				// Unicode BMP font with data stored using cmap subtable format 4
-				format4_exists = true;
-				tou::truetype::cmap_format4 format;
-				//format.format =			m_reader.get_uint16();
-				//format.length =			m_reader.get_uint16();
-				//format.language =			m_reader.get_uint16();
-				m_reader.increment_position(6);
-				format.seg_count_x2 =	m_reader.get_uint16();
-				//format.search_range =		m_reader.get_uint16();
-				//format.entry_selector =	m_reader.get_uint16();
-				//format.range_shift =		m_reader.get_uint16();
-				m_reader.increment_position(6);
-
-				m_seg_count = format.seg_count_x2 / 2;
-				for (uint64_t i = 0; i < m_seg_count; i++)
-					format.end_code.push_back(m_reader.get_uint16());
-
-				//format.reserved_pad = m_reader.get_uint16();
-				m_reader.increment_position(2);
-
-				for (uint64_t i = 0; i < m_seg_count; i++)
-					format.start_code.push_back(m_reader.get_uint16());
-
-				for (uint64_t i = 0; i < m_seg_count; i++)
-					format.id_delta.push_back(m_reader.get_int16());
-
-				m_id_range_offset_from_filestart = m_reader.get_position();
-
-				for (uint64_t i = 0; i < m_seg_count; i++)
-					format.id_range_offset.push_back(m_reader.get_uint16());
-
-				m_cmap.second = format;
-			}
-		}
-		if (!format4_exists)
+	uint16_t font_face::m_get_truetype_glyph_id(tou::vector_reader& reader, uint32_t unicode)
+	{
+		m_ensure_cmap_parsed();
+		if (unicode < 256)
+			return m_data->latin1_glyph_ids[unicode];
+		return m_find_glyph_id(reader, unicode);
+	}
+
+	uint16_t font_face::m_find_glyph_id(tou::vector_reader& reader, uint32_t unicode)
+	{
+		if (!m_data->cmap_pages.empty())
 		{
-			LOG("cmap subtable format 4 could not be found in the font file");
-			return false;
+			if (unicode > 0x10FFFF)
+				return 0;
+			return m_data->cmap_page_glyph_ids[((size_t)m_data->cmap_pages[unicode >> 8] << 8) | (unicode & 0xff)];
 		}
-		return true;
+		if (unicode > 0xFFFF)
+			return 0;
+		if (!m_data->bmp_glyph_ids.empty())
+			return m_data->bmp_glyph_ids[unicode];
+
+		// segments are sorted by end code, the first one ending at or after the codepoint is the only one that can map it
+		const font_face::cmap_format4_lookup& cmap = m_data->cmap_lookup;
+		const uint16_t* end_code = std::lower_bound(cmap.end_code.data, cmap.end_code.data + m_data->seg_count, unicode);
+		uint64_t i = end_code - cmap.end_code.data;
+		if (i == m_data->seg_count || unicode < cmap.start_code[i])
+			return 0;
+		return m_get_format4_glyph_id(reader, i, static_cast<uint16_t>(unicode));
 	}
 
-	uint16_t font_face::m_get_truetype_glyph_id(uint16_t unicode)
+	uint16_t font_face::m_get_format4_glyph_id(tou::vector_reader& reader, uint64_t i, uint16_t unicode)
 	{
-		uint16_t glyph_id = 0;
-		for (uint64_t i = 0; i < m_seg_count; i++)
-		{
-			if ((m_cmap.second.start_code[i] <= unicode) && (unicode <= m_cmap.second.end_code[i]))
-			{
-				if (m_cmap.second.id_range_offset[i] != 0)
-				{
-					uint64_t start_code_offset = (uint64_t)(unicode - m_cmap.second.start_code[i]) * 2;
-					uint64_t current_range_offset = i * 2;
-					uint64_t glyph_index_offset = m_id_range_offset_from_filestart + current_range_offset + m_cmap.second.id_range_offset[i] + start_code_offset;
+		// 'unicode' lies within segment i
+		const font_face::cmap_format4_lookup& cmap = m_data->cmap_lookup;
+		if (cmap.id_range_offset[i] == 0)
+			return static_cast<uint16_t>(unicode + cmap.id_delta[i]);
+
+		uint64_t start_code_offset = (uint64_t)(unicode - cmap.start_code[i]) * 2;
+		uint64_t current_range_offset = i * 2;
+		uint64_t glyph_index_offset = m_data->id_range_offset_from_filestart + current_range_offset + cmap.id_range_offset[i] + start_code_offset;
+
+		// cache lookups hand in an unbound reader, it is bound to the font the first time something is read
+		if (reader.size() == 0)
+			reader = m_data->reader;
+		const char* b = reader.get_bytes(glyph_index_offset, 2);
+		uint16_t glyph_id = tou::join_bytes(b[0], b[1]);
+		if (glyph_id != 0)
+			glyph_id = (glyph_id + cmap.id_delta[i]) & 0xffff;
+		return glyph_id;
+	}
 
-					glyph_id = tou::join_bytes(m_reader.get_array()[glyph_index_offset], m_reader.get_array()[glyph_index_offset + 1]);
+	uint32_t font_face::m_get_loca_offset(tou::vector_reader& reader, uint16_t glyph_id)
+	{
+		if (!m_data->loca_short.empty())
+			return ((uint32_t)m_data->loca_short[glyph_id]) * 2;
+		if (!m_data->loca_long.empty())
+			return m_data->loca_long[glyph_id];
 
-					if (glyph_id != 0)
-						glyph_id = (glyph_id + m_cmap.second.id_delta[i]) & 0xffff;
-				}
-				else
-					glyph_id = unicode + m_cmap.second.id_delta[i];
-			}
+		// lazy mode, read the entry straight from the loca table
+		if (m_data->index_to_loc_format == 0)
+		{
+			uint64_t p = (uint64_t)m_data->loca_table.offset + (uint64_t)glyph_id * 2;
+			const char* b = reader.get_bytes(p, 2);
+			return ((uint32_t)tou::join_bytes(b[0], b[1])) * 2;
 		}
-		return glyph_id;
+		uint64_t p = (uint64_t)m_data->loca_table.offset + (uint64_t)glyph_id * 4;
+		const char* b = reader.get_bytes(p, 4);
+		return tou::join_bytes({ b[0], b[1], b[2], b[3] });
+	}
+
+	truetype::long_hor_metric font_face::m_get_hmetric(tou::vector_reader& reader, uint16_t glyph_id)
+	{
+		// glyphs past the last long_hor_metric repeat the last entry
+		uint16_t i = (glyph_id < m_data->num_hori_metrics) ? glyph_id : m_data->num_hori_metrics - 1;
+		if (!m_data->hmetrics.empty())
+			return m_data->hmetrics[i];
+
+		// lazy mode, read the entry straight from the hmtx table
+		uint64_t p = (uint64_t)m_data->hmtx_table.offset + (uint64_t)i * 4;
+		const char* b = reader.get_bytes(p, 4);
+		return { tou::join_bytes(b[0], b[1]), tou::join_bytes_signed(b[2], b[3]) };
 	}
 
-	bool font_face::m_get_truetype_simple_glyph_header_data(font_face::truetype_glyph& glyph)
+	bool font_face::m_get_truetype_simple_glyph_header_data(tou::vector_reader& reader, font_face::truetype_glyph& glyph)
 	{
 		// function assumes glyph.id is valid or 0
 		bool outline_present = false;
-		if (static_cast<size_t>(glyph.id) + 1 >= m_loca_offset32.size())
-			outline_present = (m_table_records["glyf"].length != m_loca_offset32[glyph.id]);
+		uint32_t loca_offset = m_get_loca_offset(reader, glyph.id);
+		if (glyph.id >= m_data->num_glyphs)
+			outline_present = (m_data->glyf_table.length != loca_offset);
 		else
-			outline_present = (m_loca_offset32[glyph.id] != m_loca_offset32[static_cast<size_t>(glyph.id) + 1]);
+			outline_present = (loca_offset != m_get_loca_offset(reader, glyph.id + 1));
 
-		m_reader.set_position((uint64_t)m_table_records["glyf"].offset + (uint64_t)m_loca_offset32[glyph.id]);
+		reader.set_position((uint64_t)m_data->glyf_table.offset + (uint64_t)loca_offset);
 
 		if (outline_present)
 		{
-			glyph.num_contours = m_reader.get_int16();
-			glyph.x_min = m_reader.get_int16();
-			glyph.y_min = m_reader.get_int16();
-			glyph.x_max = m_reader.get_int16();
-			glyph.y_max = m_reader.get_int16();
-			glyph.advance_width = m_hmtx.hmetrics[glyph.id].advance_width;
-			glyph.left_side_bearing = m_hmtx.hmetrics[glyph.id].lsb; // TODO: scenario where lsb is not in hMetrics
+			glyph.num_contours = reader.get_int16();
+			glyph.x_min = reader.get_int16();
+			glyph.y_min = reader.get_int16();
+			glyph.x_max = reader.get_int16();
+			glyph.y_max = reader.get_int16();
+			truetype::long_hor_metric metric = m_get_hmetric(reader, glyph.id);
+			glyph.advance_width = metric.advance_width;
+			glyph.left_side_bearing = metric.lsb; // TODO: scenario where lsb is not in hMetrics
 		}
 		else
 		{
-			glyph.advance_width = m_hmtx.hmetrics[glyph.id].advance_width;
+			glyph.advance_width = m_get_hmetric(reader, glyph.id).advance_width;
 			return outline_present;
 		}
 		return outline_present;
 	}
 
-	void font_face::m_get_truetype_simple_glyph_data(font_face::truetype_glyph& glyph)
+	void font_face::m_get_truetype_simple_glyph_data(tou::vector_reader& reader, font_face::truetype_glyph& glyph)
 	{
-		// function assumes glyph has valid header information and that m_reader is positioned correctly
-		// simple glyph definition
-		for (uint64_t j = 0; j < glyph.num_contours; j++)
-			glyph.end_pts_of_contours.push_back(m_reader.get_uint16());
+		// function assumes glyph has valid header information and that reader is positioned correctly
+		// a composite has no points to read here
+		if (glyph.num_contours < 0)
+			return;
 
-		std::vector<uint16_t>::iterator result = std::max_element(glyph.end_pts_of_contours.begin(), glyph.end_pts_of_contours.end());
-		glyph.num_points = *result + 1;
+		// simple glyph definition, the point count is the largest end point so they're scanned before the outline is sized
+		const uint16_t num_contours = static_cast<uint16_t>(glyph.num_contours);
+		// get_bytes pads reads running past the end of the font with zeros, so a truncated glyph decodes like single value reads would
+		uint64_t position = reader.get_position();
+		const char* header = reader.get_bytes(position, (size_t)num_contours * 2 + 2);
+		uint16_t max_end_pt = 0;
+		for (uint16_t j = 0; j < num_contours; j++)
+			max_end_pt = std::max(max_end_pt, tou::join_bytes(header[j * 2], header[j * 2 + 1]));
+		glyph.num_points = max_end_pt + 1;
+		glyph.outline.resize(glyph.num_points, num_contours);
+		tou::big_endian_to_native(header, glyph.outline.end_points(), num_contours);
+		glyph.instruction_len = tou::join_bytes(header[num_contours * 2], header[num_contours * 2 + 1]);
+		position += (uint64_t)num_contours * 2 + 2;
 
-		glyph.instruction_len = m_reader.get_uint16();
 		if (glyph.instruction_len != 0)
 		{
-			for (uint64_t j = 0; j < glyph.instruction_len; j++)
-				glyph.instructions.push_back(m_reader.get_uint8());
+			const uint8_t* instructions = reinterpret_cast<const uint8_t*>(reader.get_bytes(position, glyph.instruction_len));
+			glyph.instructions.assign(instructions, instructions + glyph.instruction_len);
+			position += glyph.instruction_len;
 		}
-		for (uint64_t b = 0; b < glyph.num_points; b++)
-		{
-			const uint8_t flag = m_reader.get_uint8();
-			tou::truetype::glyph_flags flags_for_this_point;
-
-			flags_for_this_point.on_curve_point = ((flag & ON_CURVE_POINT) == ON_CURVE_POINT);
-			flags_for_this_point.x_short_vector = ((flag & X_SHORT_VECTOR) == X_SHORT_VECTOR);
-			flags_for_this_point.y_short_vector = ((flag & Y_SHORT_VECTOR) == Y_SHORT_VECTOR);
-			flags_for_this_point.x_is_same_or_positive_x_short_vector = ((flag & X_IS_SAME_OR_POSITIVE_X_SHORT_VECTOR) == X_IS_SAME_OR_POSITIVE_X_SHORT_VECTOR);
-			flags_for_this_point.y_is_same_or_positive_y_short_vector = ((flag & Y_IS_SAME_OR_POSITIVE_Y_SHORT_VECTOR) == Y_IS_SAME_OR_POSITIVE_Y_SHORT_VECTOR);
-			flags_for_this_point.overlap_simple = ((flag & OVERLAP_SIMPLE) == OVERLAP_SIMPLE);
 
+		// a flag and its repeat count take at most two bytes per point, the font's flag bytes are kept while the
+		// coordinates are decoded, then reduced to the bits the outline keeps
+		const uint32_t num_points = glyph.num_points;
+		const uint8_t* data = reinterpret_cast<const uint8_t*>(reader.get_bytes(position, (size_t)num_points * 2));
+		uint8_t* flags = glyph.outline.flags();
+		size_t used = 0;
+		for (uint32_t b = 0; b < num_points; b++)
+		{
+			const uint8_t flag = data[used++];
+			flags[b] = flag;
 			if ((flag & REPEAT_FLAG) == REPEAT_FLAG)
 			{
-				flags_for_this_point.repeat_flag = true;
-				flags_for_this_point.repeat_count = m_reader.get_uint8();
-				for (uint8_t v = 0; v < flags_for_this_point.repeat_count; v++)
-				{
-					glyph.flags_bool.push_back(flags_for_this_point);
-					b++;
-				}
-				glyph.flags_bool.push_back(flags_for_this_point); // for the original flag
-			}
-			else
-			{
-				flags_for_this_point.repeat_count = 0;
-				glyph.flags_bool.push_back(flags_for_this_point);
+				const uint32_t last = std::min<uint32_t>(b + data[used++], num_points - 1);
+				for (; b < last; b++)
+					flags[b + 1] = flag;
 			}
 		}
-		// ready to parse coordinate arrays...
-		for (uint64_t b = 0; b < glyph.num_points; b++)
+		position += used;
+
+		// both delta streams sized from the flags, then read together in one pass
+		size_t x_bytes = 0, y_bytes = 0;
+		for (uint32_t b = 0; b < num_points; b++)
 		{
-			if (glyph.flags_bool[b].x_short_vector)
-			{
-				// x coordinate is 1 byte
-				if (glyph.flags_bool[b].x_is_same_or_positive_x_short_vector)
-				{
-					// x coordinate is positive
-					int16_t x = (int16_t)m_reader.get_uint8();
-					if (b > 0)
-						x += glyph.x_coords[b - 1];
-					glyph.x_coords.push_back(x);
-				}
-				else
-				{
-					// x coordinate is negative
-					int16_t x = ((-1) * (int16_t)m_reader.get_uint8());
-					if (b > 0)
-						x += glyph.x_coords[b - 1];
-					glyph.x_coords.push_back(x);
-				}
-			}
-			else
-			{
-				// x coordinate is 2 bytes
-				if (glyph.flags_bool[b].x_is_same_or_positive_x_short_vector)
-				{
-					// x coordinate is identical to previous x coordinate (or 0)
-					if (b == 0)
-						glyph.x_coords.push_back(0);
-					else
-						glyph.x_coords.push_back(glyph.x_coords[b - 1]);
-				}
-				else
-				{
-					// x coordinate is a signed 16-bit delta
-					int16_t x = m_reader.get_int16();
-					if (b > 0)
-						x += glyph.x_coords[b - 1];
-					glyph.x_coords.push_back(x);
-				}
-			}
+			const uint8_t layout = DELTA_LAYOUTS[flags[b]];
+			x_bytes += layout & DELTA_WIDTH;
+			y_bytes += (layout >> 4) & DELTA_WIDTH;
 		}
-		for (uint64_t b = 0; b < glyph.num_points; b++)
+		data = reinterpret_cast<const uint8_t*>(reader.get_bytes(position, x_bytes + y_bytes + 2));
+		const uint8_t* x_stream = data;
+		const uint8_t* y_stream = data + x_bytes;
+		int16_t* x_coords = glyph.outline.x();
+		int16_t* y_coords = glyph.outline.y();
+		for (uint32_t b = 0; b < num_points; b++)
 		{
-			if (glyph.flags_bool[b].y_short_vector)
-			{
-				// y coordinate is 1 byte
-				if (glyph.flags_bool[b].y_is_same_or_positive_y_short_vector)
-				{
-					// y coordinate is positive
-					int16_t y = (int16_t)m_reader.get_uint8();
-					if (b > 0)
-						y += glyph.y_coords[b - 1];
-					glyph.y_coords.push_back(y);
-				}
-				else
-				{
-					// y coordinate is negative
-					int16_t y = ((-1) * (int16_t)m_reader.get_uint8());
-					if (b > 0)
-						y += glyph.y_coords[b - 1];
-					glyph.y_coords.push_back(y);
-				}
-			}
-			else
-			{
-				// y coordinate is 2 bytes
-				if (glyph.flags_bool[b].y_is_same_or_positive_y_short_vector)
-				{
-					// y coordinate is identical to previous y coordinate (or 0)
-					if (b == 0)
-						glyph.y_coords.push_back(0);
-					else
-						glyph.y_coords.push_back(glyph.y_coords[b - 1]);
-				}
-				else
-				{
-					// y coordinate is a signed 16-bit delta
-					int16_t y = m_reader.get_int16();
-					if (b > 0)
-						y += glyph.y_coords[b - 1];
-					glyph.y_coords.push_back(y);
-				}
-			}
+			const uint8_t layout = DELTA_LAYOUTS[flags[b]];
+			x_coords[b] = read_delta(x_stream, layout & 0x0F);
+			y_coords[b] = read_delta(y_stream, layout >> 4);
+			flags[b] &= tou::outline::ON_CURVE | tou::outline::OVERLAP;
 		}
+		reader.set_position(position + x_bytes + y_bytes);
+
+		// the deltas become absolute coordinates
+		tou::prefix_sum(x_coords, num_points);
+		tou::prefix_sum(y_coords, num_points);
 	}
 
-	void font_face::m_get_truetype_component_glyph_data(std::vector<truetype::glyph_component>& components)
+	void font_face::m_get_truetype_component_glyph_data(tou::vector_reader& reader, std::vector<truetype::glyph_component>& components)
 	{
-		// function assumes glyph has valid header information and that m_reader is positioned correctly
+		// function assumes glyph has valid header information and that reader is positioned correctly
 		bool more_components = true;
 		while (more_components)
 		{
 			truetype::glyph_component component;
-			component.flag = m_reader.get_uint16();
-			component.glyph_index = m_reader.get_uint16();
+			component.flag = reader.get_uint16();
+			component.glyph_index = reader.get_uint16();
 
 			// determine the data types of arg1 and arg2
 			if (((component.flag & ARG_1_AND_2_ARE_WORDS) == ARG_1_AND_2_ARE_WORDS) && ((component.flag & ARGS_ARE_XY_VALUES) == ARGS_ARE_XY_VALUES))
 			{
 				// arguments are signed 16-bit xy values
-				component.xy_arg1 = m_reader.get_int16();
-				component.xy_arg2 = m_reader.get_int16();
+				component.xy_arg1 = reader.get_int16();
+				component.xy_arg2 = reader.get_int16();
 			}
 			else if (((component.flag & ARG_1_AND_2_ARE_WORDS) == ARG_1_AND_2_ARE_WORDS) && ((component.flag & ARGS_ARE_XY_VALUES) != ARGS_ARE_XY_VALUES))
 			{
 				// arguments are 16-bit unsigned point numbers
-				component.pt_arg1 = m_reader.get_uint16();
-				component.pt_arg2 = m_reader.get_uint16();
+				component.pt_arg1 = reader.get_uint16();
+				component.pt_arg2 = reader.get_uint16();
 			}
 			else if (((component.flag & ARG_1_AND_2_ARE_WORDS) != ARG_1_AND_2_ARE_WORDS) && ((component.flag & ARGS_ARE_XY_VALUES) == ARGS_ARE_XY_VALUES))
 			{
 				// arguments are signed 8-bit xy values
-				component.xy_arg1 = static_cast<int16_t>(m_reader.get_array()[m_reader.get_position()]);
-				component.xy_arg2 = static_cast<int16_t>(m_reader.get_array()[m_reader.get_position() + 1]);
-				m_reader.increment_position(2);
+				const char* args = reader.get_bytes(reader.get_position(), 2);
+				component.xy_arg1 = static_cast<int16_t>(args[0]);
+				component.xy_arg2 = static_cast<int16_t>(args[1]);
+				reader.increment_position(2);
 			}
 			else
 			{
 				// arguments are 8-bit unsigned point numbers
-				component.pt_arg1 = static_cast<uint16_t>(m_reader.get_uint8());
-				component.pt_arg2 = static_cast<uint16_t>(m_reader.get_uint8());
+				component.pt_arg1 = static_cast<uint16_t>(reader.get_uint8());
+				component.pt_arg2 = static_cast<uint16_t>(reader.get_uint8());
 			}
 
 			component.round_to_nearest_grid_line = ((component.flag & ROUND_XY_TO_GRID) == ROUND_XY_TO_GRID);
@@ -857,21 +2106,21 @@ namespace tou
 			if ((component.flag & WE_HAVE_A_SCALE) == WE_HAVE_A_SCALE)
 			{
 				// simple scale for the component
-				component.scale = m_reader.get_int16();
+				component.scale = reader.get_int16();
 			}
 			else if ((component.flag & WE_HAVE_AN_X_AND_Y_SCALE) == WE_HAVE_AN_X_AND_Y_SCALE)
 			{
 				// the x direction will use a difference scale from the y direction
-				component.x_scale = m_reader.get_int16();
-				component.y_scale = m_reader.get_int16();
+				component.x_scale = reader.get_int16();
+				component.y_scale = reader.get_int16();
 			}
 			else if ((component.flag & WE_HAVE_A_TWO_BY_TWO) == WE_HAVE_A_TWO_BY_TWO)
 			{
 				// 2 by 2 transformation to scale this component
-				component.x_scale = m_reader.get_int16();
-				component.scale01 = m_reader.get_int16();
-				component.scale10 = m_reader.get_int16();
-				component.y_scale = m_reader.get_int16();
+				component.x_scale = reader.get_int16();
+				component.scale01 = reader.get_int16();
+				component.scale10 = reader.get_int16();
+				component.y_scale = reader.get_int16();
 			}
 
 			more_components = ((component.flag & MORE_COMPONENTS) == MORE_COMPONENTS);
@@ -889,114 +2138,371 @@ namespace tou
 
 	}
 
-	void font_face::m_get_truetype_glyph_data_by_id(font_face::truetype_glyph& glyph, uint16_t glyph_id)
+	void font_face::m_get_truetype_glyph_data_by_id(tou::vector_reader& reader, font_face::truetype_glyph& glyph, uint16_t glyph_id, std::vector<truetype::glyph_component>& components)
 	{
-		// this overload function assumes we are getting a simple glyph
 		if (glyph.id != glyph_id)
 			glyph.id = glyph_id;
 
-		if (!m_get_truetype_simple_glyph_header_data(glyph)) // responsible for positioning m_reader
+		if (!m_get_truetype_simple_glyph_header_data(reader, glyph)) // responsible for positioning reader
 			return;
 
-		// simple glyph description
-		m_get_truetype_simple_glyph_data(glyph);
+		if (glyph.num_contours >= 0)
+		{
+			// simple glyph description
+			m_get_truetype_simple_glyph_data(reader, glyph);
+		}
+		else if (glyph.num_contours < 0)
+		{
+			// composite glyph description
+			m_get_truetype_component_glyph_data(reader, components);
+		}
 	}
 
-	void font_face::m_get_truetype_glyph_data_by_id(font_face::truetype_glyph& glyph, uint16_t glyph_id, std::vector<truetype::glyph_component>& components)
+	void font_face::m_get_cff_glyph_data(tou::vector_reader& reader, font_face::truetype_glyph& glyph)
 	{
-		if (glyph.id != glyph_id)
-			glyph.id = glyph_id;
+		cff::path path;
+		if (!cff::decode_glyph(reader, *m_data->cff, glyph.id, path))
+		{
+			LOG("The charstring of glyph " << glyph.id << " could not be decoded");
+			path.ops.clear();
+		}
 
-		if (!m_get_truetype_simple_glyph_header_data(glyph)) // responsible for positioning m_reader
+		truetype::long_hor_metric metric = m_get_hmetric(reader, glyph.id);
+		glyph.advance_width = metric.advance_width;
+		if (path.ops.empty())
 			return;
+		glyph.left_side_bearing = metric.lsb;
 
-		if (glyph.num_contours >= 0)
+		// the point count is only known once the path is walked, so points are collected here and packed at the end
+		std::vector<int16_t> x_coords, y_coords;
+		std::vector<uint8_t> flags;
+		std::vector<uint16_t> end_pts;
+		auto add_point = [&](tou::fvec2 p, bool on_curve)
 		{
-			// simple glyph description
-			m_get_truetype_simple_glyph_data(glyph);
+			flags.push_back(on_curve ? tou::outline::ON_CURVE : 0);
+			x_coords.push_back(static_cast<int16_t>(std::lround(p.x)));
+			y_coords.push_back(static_cast<int16_t>(std::lround(p.y)));
+		};
+
+		size_t contour_start = 0;
+		auto close_contour = [&]()
+		{
+			// contours close implicitly, so an explicit return to the start point is dropped
+			size_t n = x_coords.size() - contour_start;
+			if (n > 1 && flags.back() == tou::outline::ON_CURVE &&
+				x_coords.back() == x_coords[contour_start] && y_coords.back() == y_coords[contour_start])
+			{
+				flags.pop_back();
+				x_coords.pop_back();
+				y_coords.pop_back();
+				n--;
+			}
+
+			// a lone moveto encloses nothing
+			if (n < 2)
+			{
+				flags.resize(contour_start);
+				x_coords.resize(contour_start);
+				y_coords.resize(contour_start);
+				return;
+			}
+			end_pts.push_back(static_cast<uint16_t>(x_coords.size() - 1));
+		};
+
+		// the rasterizer walks quadratic segments only, so each cubic is split into pieces that are each
+		// within 'tolerance' font units of a single quadratic
+		constexpr float tolerance = 1.0f;
+		constexpr int max_pieces = 8;
+		tou::fvec2 current;
+		size_t p = 0;
+		for (size_t i = 0; i < path.ops.size(); i++)
+		{
+			if (path.ops[i] == cff::path_op::move_to)
+			{
+				if (i != 0)
+					close_contour();
+				contour_start = x_coords.size();
+				current = path.points[p++];
+				add_point(current, true);
+			}
+			else if (path.ops[i] == cff::path_op::line_to)
+			{
+				current = path.points[p++];
+				add_point(current, true);
+			}
+			else
+			{
+				const tou::fvec2 p0 = current, c1 = path.points[p], c2 = path.points[p + 1], p3 = path.points[p + 2];
+				p += 3;
+
+				// distance between the cubic and its best single quadratic approximation, which shrinks with the cube of the piece count
+				float ex = p3.x - 3.0f * c2.x + 3.0f * c1.x - p0.x;
+				float ey = p3.y - 3.0f * c2.y + 3.0f * c1.y - p0.y;
+				float error = std::sqrt(ex * ex + ey * ey) * std::sqrt(3.0f) / 36.0f;
+				int pieces = std::clamp(static_cast<int>(std::ceil(std::cbrt(error / tolerance))), 1, max_pieces);
+
+				auto point_at = [&](float t) -> tou::fvec2
+				{
+					float u = 1.0f - t;
+					float a = u * u * u, b = 3.0f * u * u * t, c = 3.0f * u * t * t, d = t * t * t;
+					return { a * p0.x + b * c1.x + c * c2.x + d * p3.x, a * p0.y + b * c1.y + c * c2.y + d * p3.y };
+				};
+				auto tangent_at = [&](float t) -> tou::fvec2
+				{
+					float u = 1.0f - t;
+					float a = 3.0f * u * u, b = 6.0f * u * t, c = 3.0f * t * t;
+					return { a * (c1.x - p0.x) + b * (c2.x - c1.x) + c * (p3.x - c2.x), a * (c1.y - p0.y) + b * (c2.y - c1.y) + c * (p3.y - c2.y) };
+				};
+
+				float dt = 1.0f / pieces;
+				tou::fvec2 start = p0, start_tangent = tangent_at(0.0f);
+				for (int k = 1; k <= pieces; k++)
+				{
+					float t = k * dt;
+					tou::fvec2 end = (k == pieces) ? p3 : point_at(t), end_tangent = tangent_at(t);
+
+					// control point of the quadratic closest to the piece, from its cubic control points
+					tou::fvec2 k1 = { start.x + start_tangent.x * dt / 3.0f, start.y + start_tangent.y * dt / 3.0f };
+					tou::fvec2 k2 = { end.x - end_tangent.x * dt / 3.0f, end.y - end_tangent.y * dt / 3.0f };
+					add_point({ (3.0f * (k1.x + k2.x) - (start.x + end.x)) / 4.0f, (3.0f * (k1.y + k2.y) - (start.y + end.y)) / 4.0f }, false);
+					add_point(end, true);
+
+					start = end;
+					start_tangent = end_tangent;
+				}
+				current = p3;
+			}
 		}
-		else if (glyph.num_contours < 0)
+		close_contour();
+
+		if (x_coords.size() > UINT16_MAX)
 		{
-			// composite glyph description
-			m_get_truetype_component_glyph_data(components);
+			LOG("The outline of glyph " << glyph.id << " has too many points");
+			return;
+		}
+
+		glyph.outline.resize(static_cast<uint16_t>(x_coords.size()), static_cast<uint16_t>(end_pts.size()));
+		std::copy(x_coords.begin(), x_coords.end(), glyph.outline.x());
+		std::copy(y_coords.begin(), y_coords.end(), glyph.outline.y());
+		std::copy(flags.begin(), flags.end(), glyph.outline.flags());
+		std::copy(end_pts.begin(), end_pts.end(), glyph.outline.end_points());
+		glyph.num_contours = static_cast<int16_t>(glyph.outline.num_contours());
+		glyph.num_points = glyph.outline.num_points();
+		glyph.outline.bounds(glyph.x_min, glyph.y_min, glyph.x_max, glyph.y_max);
+	}
+
+	void font_face::m_apply_glyph_variations(tou::vector_reader& reader, font_face::truetype_glyph& glyph, const std::vector<int16_t>& coordinates)
+	{
+		// the outline is followed by 4 phantom points, the first two sit on the glyph origin and at its advance
+		size_t n = glyph.num_points;
+		std::vector<tou::fvec2> points(n + 4);
+		int16_t* x_coords = glyph.outline.x();
+		int16_t* y_coords = glyph.outline.y();
+		for (size_t i = 0; i < n; i++)
+			points[i] = { FLT(x_coords[i]), FLT(y_coords[i]) };
+		float origin = FLT(glyph.x_min - glyph.left_side_bearing);
+		points[n] = { origin, 0.0f };
+		points[n + 1] = { origin + glyph.advance_width, 0.0f };
+
+		std::vector<tou::fvec2> deltas;
+		if (!tou::variations::glyph_deltas(reader, *m_data->variations, glyph.id, coordinates, points, { glyph.outline.end_points(), glyph.outline.num_contours() }, deltas))
+		{
+			LOG("The variation data of glyph " << glyph.id << " is malformed, its default outline is used");
+			return;
+		}
+
+		auto round = [](float v) { return static_cast<int16_t>(std::floor(v + 0.5f)); };
+		for (size_t i = 0; i < n; i++)
+		{
+			x_coords[i] = round(points[i].x + deltas[i].x);
+			y_coords[i] = round(points[i].y + deltas[i].y);
+		}
+		int16_t left = round(points[n].x + deltas[n].x);
+		int16_t right = round(points[n + 1].x + deltas[n + 1].x);
+		glyph.advance_width = static_cast<uint16_t>(std::max(0, right - left));
+
+		if (glyph.outline.bounds(glyph.x_min, glyph.y_min, glyph.x_max, glyph.y_max))
+			glyph.left_side_bearing = glyph.x_min - left;
+	}
+
+	int16_t font_face::m_apply_component_variations(tou::vector_reader& reader, font_face::truetype_glyph& glyph, std::vector<truetype::glyph_component>& components, const std::vector<int16_t>& coordinates)
+	{
+		// a composite's points are its component offsets, followed by the phantom points
+		size_t n = components.size();
+		std::vector<tou::fvec2> points(n + 4);
+		for (size_t i = 0; i < n; i++)
+			points[i] = { FLT(components[i].xy_arg1), FLT(components[i].xy_arg2) };
+		int16_t origin = glyph.x_min - glyph.left_side_bearing;
+		points[n] = { FLT(origin), 0.0f };
+		points[n + 1] = { FLT(origin + glyph.advance_width), 0.0f };
+
+		std::vector<tou::fvec2> deltas;
+		if (!tou::variations::glyph_deltas(reader, *m_data->variations, glyph.id, coordinates, points, {}, deltas))
+		{
+			LOG("The variation data of glyph " << glyph.id << " is malformed, its default component offsets are used");
+			return origin;
+		}
+
+		auto round = [](float v) { return static_cast<int16_t>(std::floor(v + 0.5f)); };
+		for (size_t i = 0; i < n; i++)
+		{
+			// offsets given as point numbers to match have nothing to move
+			if ((components[i].flag & ARGS_ARE_XY_VALUES) == ARGS_ARE_XY_VALUES)
+			{
+				components[i].xy_arg1 = round(points[i].x + deltas[i].x);
+				components[i].xy_arg2 = round(points[i].y + deltas[i].y);
+			}
 		}
+		int16_t left = round(points[n].x + deltas[n].x);
+		int16_t right = round(points[n + 1].x + deltas[n + 1].x);
+		glyph.advance_width = static_cast<uint16_t>(std::max(0, right - left));
+		return left;
 	}
 
-	font_face::truetype_glyph font_face::m_get_truetype_glyph(uint16_t unicode)
+	font_face::truetype_glyph font_face::m_get_truetype_glyph(tou::vector_reader& reader, uint16_t glyph_id, font_face::glyph_cache& instance, const font_face::component_path& path)
 	{
+		const std::vector<int16_t>& coordinates = instance.coordinates;
 		font_face::truetype_glyph glyph;
 		std::vector<truetype::glyph_component> components;
-		glyph.id = m_get_truetype_glyph_id(unicode);
-		m_get_truetype_glyph_data_by_id(glyph, glyph.id, components);
+		glyph.id = glyph_id;
+		if (m_data->cff)
+		{
+			m_get_cff_glyph_data(reader, glyph);
+			return glyph;
+		}
+		m_get_truetype_glyph_data_by_id(reader, glyph, glyph.id, components);
+
+		// an empty 'coordinates' is the default instance, which needs no deltas
+		const bool instanced = !coordinates.empty() && m_data->variations;
+		if (instanced && components.empty())
+			m_apply_glyph_variations(reader, glyph, coordinates);
 
 		if (components.size() != 0)
 		{
-			glyph.num_contours = 0;
-			// construct the composite glyph
-			// this block calls m_get_glyph_data_by_id for all components
-			// this block assumes m_reader is positioned directly after the last of component data (always the case if components.size() > 0)
-			
-			//std::vector<uint8_t> instructions;
-			//if (components[components.size() - 1].instructions_present)
-			//{
-			//	uint16_t instruction_len = m_reader.get_uint16();
-			//	if (instruction_len != 0)
-			//	{
-			//		for (uint16_t j = 0; j < instruction_len; j++)
-			//			instructions.push_back(m_reader.get_uint8());
-			//	}
-			//}
-
-			//std::vector<truetype_glyph> glyph_pieces; // temp for debugging
-			int glyph_index_for_base = 0;
+			int16_t origin = glyph.x_min - glyph.left_side_bearing;
+			if (instanced)
+				origin = m_apply_component_variations(reader, glyph, components, coordinates);
+
+			// maxp says how deep components nest, fonts leaving it at 0 still get one level and none get more than MAX_COMPONENT_DEPTH
+			if (path.depth >= std::clamp<uint16_t>(m_data->max_component_depth, 1, MAX_COMPONENT_DEPTH))
+			{
+				LOG("The components of glyph " << glyph.id << " nest deeper than maxp allows, they are left out");
+				components.clear();
+				glyph.components_left_out = true;
+			}
+			font_face::component_path inner = path;
+			if (!components.empty())
+				inner.glyph_ids[inner.depth++] = glyph_id;
+			glyph.component_depth = 1;
+
+			auto round = [](float v) { return static_cast<int16_t>(std::floor(v + 0.5f)); };
+			auto f2dot14 = [](uint16_t v) { return static_cast<int16_t>(v) / 16384.0f; };
+
+			uint16_t glyph_index_for_base = 0;
+			truetype::long_hor_metric base_metric;
 			for (const auto& comp : components)
 			{
-				font_face::truetype_glyph glyph_piece;
-				m_get_truetype_glyph_data_by_id(glyph_piece, comp.glyph_index);
+				// a component referring back to a composite on the path would nest forever
+				if (std::find(inner.glyph_ids.begin(), inner.glyph_ids.begin() + inner.depth, comp.glyph_index) != inner.glyph_ids.begin() + inner.depth)
+				{
+					LOG("A component of glyph " << glyph.id << " refers back to glyph " << comp.glyph_index << ", it is left out");
+					glyph.components_left_out = true;
+					continue;
+				}
+
+				// components come through the glyph cache, so a base letter shared by many accented ones is decoded once
+				std::shared_ptr<const font_face::truetype_glyph> piece = m_get_cached_glyph_by_id(reader, comp.glyph_index, instance, inner);
+				glyph.component_depth = std::max<uint16_t>(glyph.component_depth, piece->component_depth + 1);
+				glyph.components_left_out |= piece->components_left_out;
 
 				if (comp.use_base_glyph_aw_and_lsb)
+				{
 					glyph_index_for_base = comp.glyph_index;
-				
-				if (comp.xy_arg1 || comp.xy_arg2)
+					base_metric = { piece->advance_width, piece->left_side_bearing };
+				}
+
+				// x' = xx * x + xy * y, y' = yx * x + yy * y
+				float xx = 1.0f, xy = 0.0f, yx = 0.0f, yy = 1.0f;
+				bool transformed = true;
+				if ((comp.flag & WE_HAVE_A_SCALE) == WE_HAVE_A_SCALE)
+					xx = yy = f2dot14(comp.scale);
+				else if ((comp.flag & WE_HAVE_AN_X_AND_Y_SCALE) == WE_HAVE_AN_X_AND_Y_SCALE)
 				{
-					// modify data for the piece if needed
-					// xy_arg1 is x offset for points in piece, xy_arg2 is y offset
-					// for pieces, we only care about point data and endpoint data
+					xx = f2dot14(comp.x_scale);
+					yy = f2dot14(comp.y_scale);
+				}
+				else if ((comp.flag & WE_HAVE_A_TWO_BY_TWO) == WE_HAVE_A_TWO_BY_TWO)
+				{
+					xx = f2dot14(comp.x_scale);
+					yx = f2dot14(comp.scale01);
+					xy = f2dot14(comp.scale10);
+					yy = f2dot14(comp.y_scale);
+				}
+				else
+					transformed = false;
 
-					for (int i = 0; i < glyph_piece.num_points; i++)
+				// the cached outline is shared, a transformed component is drawn from a copy
+				const tou::outline::packed* outline = &piece->outline;
+				tou::outline::packed transformed_outline;
+				if (transformed)
+				{
+					transformed_outline = piece->outline;
+					int16_t* x_coords = transformed_outline.x();
+					int16_t* y_coords = transformed_outline.y();
+					for (size_t i = 0; i < transformed_outline.num_points(); i++)
 					{
-						glyph_piece.x_coords[i] += comp.xy_arg1;
-						glyph_piece.y_coords[i] += comp.xy_arg2;
+						float x = x_coords[i], y = y_coords[i];
+						x_coords[i] = round(xx * x + xy * y);
+						y_coords[i] = round(yx * x + yy * y);
 					}
-
+					outline = &transformed_outline;
 				}
-				//else if (comp.pt_arg1 && comp.pt_arg2)
-				//{
-				//	// pt arg1 is original point to be matched to new composites entry as pt arg2
-				//}
-				for (int i = 0; i < glyph_piece.num_contours; i++)
+
+				int16_t dx = comp.xy_arg1, dy = comp.xy_arg2;
+				if ((comp.flag & ARGS_ARE_XY_VALUES) != ARGS_ARE_XY_VALUES)
 				{
-					glyph_piece.end_pts_of_contours[i] += glyph.num_points;
-					glyph.end_pts_of_contours.push_back(glyph_piece.end_pts_of_contours[i]);
+					// point matching, the component moves so its point pt_arg2 lands on point pt_arg1 of the glyph so far
+					if (comp.pt_arg1 < glyph.outline.num_points() && comp.pt_arg2 < outline->num_points())
+					{
+						dx = glyph.outline.x()[comp.pt_arg1] - outline->x()[comp.pt_arg2];
+						dy = glyph.outline.y()[comp.pt_arg1] - outline->y()[comp.pt_arg2];
+					}
+					else
+					{
+						LOG("A component of glyph " << glyph.id << " matches a point it doesn't have");
+						dx = dy = 0;
+					}
 				}
-				glyph.num_contours += glyph_piece.num_contours;
-				glyph.num_points += glyph_piece.num_points;
-				for (int i = 0; i < glyph_piece.num_points; i++)
+				else if (transformed && comp.scaled_component_offset)
 				{
-					glyph.flags_bool.push_back(glyph_piece.flags_bool[i]);
-					glyph.x_coords.push_back(glyph_piece.x_coords[i]);
-					glyph.y_coords.push_back(glyph_piece.y_coords[i]);
+					dx = round(xx * comp.xy_arg1 + xy * comp.xy_arg2);
+					dy = round(yx * comp.xy_arg1 + yy * comp.xy_arg2);
 				}
-				
-				//glyph_pieces.push_back(glyph_piece); // temp
+
+				// the piece's points and contours go after the ones before it
+				if (!glyph.outline.append(*outline, dx, dy))
+					LOG("The outline of glyph " << glyph.id << " has too many points");
 			}
+			glyph.num_contours = static_cast<int16_t>(glyph.outline.num_contours());
+			glyph.num_points = glyph.outline.num_points();
 
-			if (glyph_index_for_base != 0)
+			if (instanced)
+			{
+				// the stored bounding box is the default instance's, the side bearing follows the moved outline
+				glyph.outline.bounds(glyph.x_min, glyph.y_min, glyph.x_max, glyph.y_max);
+				glyph.left_side_bearing = glyph.x_min - origin;
+				if (glyph_index_for_base != 0)
+				{
+					glyph.advance_width = base_metric.advance_width;
+					glyph.left_side_bearing = base_metric.lsb;
+				}
+			}
+			else if (glyph_index_for_base != 0)
 			{
-				glyph.advance_width = m_hmtx.hmetrics[glyph_index_for_base].advance_width;
-				glyph.left_side_bearing = m_hmtx.hmetrics[glyph_index_for_base].lsb; // TODO: scenario where lsb is not in hMetrics
+				truetype::long_hor_metric metric = m_get_hmetric(reader, glyph_index_for_base);
+				glyph.advance_width = metric.advance_width;
+				glyph.left_side_bearing = metric.lsb; // TODO: scenario where lsb is not in hMetrics
 			}
-			
 		}
 
 		return glyph;
@@ -1007,39 +2513,72 @@ namespace tou
 		return (a.value.vectorial < b.value.vectorial);
 	}
 
-	font_face::bitmap_glyph font_face::m_rasterize_truetype_glyph(const font_face::truetype_glyph& g, float pointsize, bool render_outline, bool render_inside)
+	bool font_face::m_draw_embedded_bitmap(uint32_t unicode, float pointsize, font_face::bitmap_glyph& out)
 	{
-		float dpi = 300.0f;
-		font_face::truetype_glyph glyf = g;
-		font_face::bitmap_glyph glyph;
-		glyph.id = glyf.id;
-		
-		// we don't like negative values
-		if (glyf.x_min < 0)
-		{
-			for (auto& x : glyf.x_coords)
-				x += (-1 * glyf.x_min);
+		// strikes are drawn for the default instance only
+		if (!m_lookup->instance.load()->coordinates.empty())
+			return false;
 
-			glyf.x_max += (-1 * glyf.x_min);
-			glyf.x_min += (-1 * glyf.x_min);
-		}
-		if (glyf.y_min < 0)
-		{
-			for (auto& y : glyf.y_coords)
-				y += (-1 * glyf.y_min);
+		// strikes are matched on whole pixels per em, as FreeType does
+		long ppem = std::lround(pointsize * RENDER_DPI / 72.0f);
+		if (ppem <= 0 || ppem > 255)
+			return false;
+		const tou::sbit::strike* strike = tou::sbit::find_strike(*m_data->bitmap_strikes, static_cast<uint16_t>(ppem));
+		if (strike == nullptr)
+			return false;
+
+		tou::vector_reader reader = m_data->reader;
+		uint16_t glyph_id = m_get_truetype_glyph_id(reader, unicode);
+		tou::sbit::glyph g;
+		if (glyph_id == 0 || !tou::sbit::decode_glyph(reader, *m_data->bitmap_strikes, *strike, glyph_id, g))
+			return false;
+
+		// laid out like a rasterized glyph, the image starts at the origin unless the bitmap reaches left of or below it
+		int32_t left = std::min<int32_t>(0, g.bearing_x);
+		int32_t bottom = std::min<int32_t>(0, g.bearing_y - g.height);
+		uint32_t width = static_cast<uint32_t>(std::max<int32_t>(1, g.bearing_x + g.width - left));
+		uint32_t height = static_cast<uint32_t>(std::max<int32_t>(1, g.bearing_y - bottom));
 
-			glyf.y_max += (-1 * glyf.y_min);
-			glyf.y_min += (-1 * glyf.y_min);
+		out.id = glyph_id;
+		out.advance_x = g.advance;
+		out.image.resize(width, height);
+		for (uint32_t y = 0; y < g.height; y++)
+		{
+			// coverage rows run top down, image rows bottom up
+			uint32_t py = static_cast<uint32_t>(g.bearing_y - 1 - static_cast<int32_t>(y) - bottom);
+			for (uint32_t x = 0; x < g.width; x++)
+			{
+				uint8_t coverage = g.coverage[(size_t)y * g.width + x];
+				if (coverage == 0)
+					continue;
+				uint8_t shade = static_cast<uint8_t>(255 - coverage);
+				out.image[{ static_cast<uint32_t>(g.bearing_x - left) + x, py }] = { shade, shade, shade, 0xFF };
+			}
 		}
+		return true;
+	}
+
+	font_face::bitmap_glyph font_face::m_rasterize_truetype_glyph(const font_face::truetype_glyph& glyf, float pointsize, bool render_outline, bool render_inside)
+	{
+		float dpi = RENDER_DPI;
+		font_face::bitmap_glyph glyph;
+		glyph.id = glyf.id;
+		
+		// we don't like negative values, the outline is shifted while it is walked so the cached glyph isn't copied
+		// the sums wrap like int16_t coordinates do
+		const int16_t x_shift = glyf.x_min < 0 ? static_cast<int16_t>(-glyf.x_min) : 0;
+		const int16_t y_shift = glyf.y_min < 0 ? static_cast<int16_t>(-glyf.y_min) : 0;
+		const int16_t x_min = static_cast<int16_t>(glyf.x_min + x_shift), x_max = static_cast<int16_t>(glyf.x_max + x_shift);
+		const int16_t y_min = static_cast<int16_t>(glyf.y_min + y_shift), y_max = static_cast<int16_t>(glyf.y_max + y_shift);
 
-		glyph.advance_x = roundf26(convert_to_f26(convert_to_pixel(static_cast<float>(glyf.advance_width), pointsize, dpi, static_cast<float>(m_units_per_em)))) / 64;
+		glyph.advance_x = roundf26(convert_to_f26(convert_to_pixel(static_cast<float>(glyf.advance_width), pointsize, dpi, static_cast<float>(m_data->units_per_em)))) / 64;
 
 		// convert x_min, x_max, y_min, y_max to pixel values then convert and grid-fit the bounding box
 		tou::glyph_bounding_box box;
-		box.x_min = tou::floorf26(tou::convert_to_f26(tou::convert_to_pixel(static_cast<float>(glyf.x_min), pointsize, dpi, static_cast<float>(m_units_per_em))));
-		box.x_max = tou::ceilf26( tou::convert_to_f26(tou::convert_to_pixel(static_cast<float>(glyf.x_max), pointsize, dpi, static_cast<float>(m_units_per_em))));
-		box.y_min = tou::floorf26(tou::convert_to_f26(tou::convert_to_pixel(static_cast<float>(glyf.y_min), pointsize, dpi, static_cast<float>(m_units_per_em))));
-		box.y_max = tou::ceilf26( tou::convert_to_f26(tou::convert_to_pixel(static_cast<float>(glyf.y_max), pointsize, dpi, static_cast<float>(m_units_per_em))));
+		box.x_min = tou::floorf26(tou::convert_to_f26(tou::convert_to_pixel(static_cast<float>(x_min), pointsize, dpi, static_cast<float>(m_data->units_per_em))));
+		box.x_max = tou::ceilf26( tou::convert_to_f26(tou::convert_to_pixel(static_cast<float>(x_max), pointsize, dpi, static_cast<float>(m_data->units_per_em))));
+		box.y_min = tou::floorf26(tou::convert_to_f26(tou::convert_to_pixel(static_cast<float>(y_min), pointsize, dpi, static_cast<float>(m_data->units_per_em))));
+		box.y_max = tou::ceilf26( tou::convert_to_f26(tou::convert_to_pixel(static_cast<float>(y_max), pointsize, dpi, static_cast<float>(m_data->units_per_em))));
 
 		// get pixel dimensions of bitmap
 		uint32_t width = ((box.x_max) / 64) + (((box.x_min / 64)) + 1);
@@ -1048,10 +2587,14 @@ namespace tou
 
 		std::vector<tou::glyph_outline_segment> segmented_outline;
 		size_t coord_array_position = 0;
+		const int16_t* x_coords = glyf.outline.x();
+		const int16_t* y_coords = glyf.outline.y();
+		auto x_at = [x_coords, x_shift](size_t k) { return static_cast<int16_t>(x_coords[k] + x_shift); };
+		auto y_at = [y_coords, y_shift](size_t k) { return static_cast<int16_t>(y_coords[k] + y_shift); };
 
 		for (int16_t i = 0; i < glyf.num_contours; i++) // we assume num_contours is not negative
 		{
-			int endpoint = glyf.end_pts_of_contours[i];
+			int endpoint = glyf.outline.end_points()[i];
 			bool phantom_point = false;
 			tou::ivec2 phantom_point_value = { 0, 0 };
 
@@ -1059,17 +2602,17 @@ namespace tou
 			{
 				if (j != endpoint)
 				{
-					if (glyf.flags_bool[j].on_curve_point && glyf.flags_bool[j + 1].on_curve_point)
+					if (glyf.outline.on_curve(j) && glyf.outline.on_curve(j + 1))
 					{
 						//////////////////////////////////////////////////////////////////////////////////////////////
 						//////////////////////////////////////////////////////////////////////////////////////////////
 						//////////////////////////////////////////////////////////////////////////////////////////////
 						tou::glyph_outline_segment seg;
-						tou::calculate_segment_path(seg, pointsize, dpi, FLT(m_units_per_em), FLT(glyf.x_coords[j]), FLT(glyf.x_coords[j + 1]), FLT(glyf.y_coords[j]), FLT(glyf.y_coords[j + 1]), false, 0.0f, 0.0f);
+						tou::calculate_segment_path(seg, pointsize, dpi, FLT(m_data->units_per_em), FLT(x_at(j)), FLT(x_at(j + 1)), FLT(y_at(j)), FLT(y_at(j + 1)), false, 0.0f, 0.0f);
 						segmented_outline.push_back(seg);
 
 					}
-					else if (glyf.flags_bool[j].on_curve_point && !glyf.flags_bool[j + 1].on_curve_point)
+					else if (glyf.outline.on_curve(j) && !glyf.outline.on_curve(j + 1))
 					{
 						//////////////////////////////////////////////////////////////////////////////////////////////
 						//////////////////////////////////////////////////////////////////////////////////////////////
@@ -1077,25 +2620,25 @@ namespace tou
 						size_t array_pos_of_p2 = j + 2;
 						if (array_pos_of_p2 > endpoint) array_pos_of_p2 = coord_array_position; // we've reached the end of this section of the glyph, make sure to set coord_array_position appropriately
 
-						tou::ivec2 p2 = { static_cast<uint32_t>(glyf.x_coords[array_pos_of_p2]), static_cast<uint32_t>(glyf.y_coords[array_pos_of_p2]) };
+						tou::ivec2 p2 = { static_cast<uint32_t>(x_at(array_pos_of_p2)), static_cast<uint32_t>(y_at(array_pos_of_p2)) };
 
-						if (!glyf.flags_bool[array_pos_of_p2].on_curve_point)
+						if (!glyf.outline.on_curve(array_pos_of_p2))
 						{
 							// find phantom point and set it equal to p2
 							phantom_point = true;
-							p2 = tou::midpoint(glyf.x_coords[j + 1], glyf.x_coords[array_pos_of_p2], glyf.y_coords[j + 1], glyf.y_coords[array_pos_of_p2]);
+							p2 = tou::midpoint(x_at(j + 1), x_at(array_pos_of_p2), y_at(j + 1), y_at(array_pos_of_p2));
 							phantom_point_value = p2; //p2 needs to be held somewhere to be used as p1 of next control point
 						}
 
 						tou::glyph_outline_segment seg;
-						tou::calculate_segment_path(seg, pointsize, dpi, FLT(m_units_per_em), FLT(glyf.x_coords[j]), FLT(p2.x), FLT(glyf.y_coords[j]), FLT(p2.y), true, FLT(glyf.x_coords[j + 1]), FLT(glyf.y_coords[j + 1]));
+						tou::calculate_segment_path(seg, pointsize, dpi, FLT(m_data->units_per_em), FLT(x_at(j)), FLT(p2.x), FLT(y_at(j)), FLT(p2.y), true, FLT(x_at(j + 1)), FLT(y_at(j + 1)));
 						segmented_outline.push_back(seg);
 						
 						j++; // 'jump to p2' (this will terminate the for loop for edge case) (the j++ in the for statement completes our travel to p2)
 						if (j + 1 > endpoint) coord_array_position = j + 1;
 
 					}
-					else if (!glyf.flags_bool[j].on_curve_point && glyf.flags_bool[j + 1].on_curve_point && phantom_point)
+					else if (!glyf.outline.on_curve(j) && glyf.outline.on_curve(j + 1) && phantom_point)
 					{
 						//////////////////////////////////////////////////////////////////////////////////////////////
 						//////////////////////////////////////////////////////////////////////////////////////////////
@@ -1107,11 +2650,11 @@ namespace tou
 						tou::ivec2 p1 = phantom_point_value;
 
 						tou::glyph_outline_segment seg;
-						tou::calculate_segment_path(seg, pointsize, dpi, FLT(m_units_per_em), FLT(p1.x), FLT(glyf.x_coords[j + 1]), FLT(p1.y), FLT(glyf.y_coords[j + 1]), true, FLT(glyf.x_coords[j]), FLT(glyf.y_coords[j]));
+						tou::calculate_segment_path(seg, pointsize, dpi, FLT(m_data->units_per_em), FLT(p1.x), FLT(x_at(j + 1)), FLT(p1.y), FLT(y_at(j + 1)), true, FLT(x_at(j)), FLT(y_at(j)));
 						segmented_outline.push_back(seg);
 
 					}
-					else if (!glyf.flags_bool[j].on_curve_point && !glyf.flags_bool[j + 1].on_curve_point && phantom_point)
+					else if (!glyf.outline.on_curve(j) && !glyf.outline.on_curve(j + 1) && phantom_point)
 					{
 						//////////////////////////////////////////////////////////////////////////////////////////////
 						//////////////////////////////////////////////////////////////////////////////////////////////
@@ -1121,28 +2664,28 @@ namespace tou
 						size_t array_pos_of_unrelated_control_point = j + 1;
 						if (array_pos_of_unrelated_control_point > endpoint) array_pos_of_unrelated_control_point = coord_array_position; // we've reached the end of a section of the glyph, make sure to set coord_array_position appropriately
 
-						tou::ivec2 p2 = tou::midpoint(glyf.x_coords[j], glyf.x_coords[array_pos_of_unrelated_control_point], glyf.y_coords[j], glyf.y_coords[array_pos_of_unrelated_control_point]);
+						tou::ivec2 p2 = tou::midpoint(x_at(j), x_at(array_pos_of_unrelated_control_point), y_at(j), y_at(array_pos_of_unrelated_control_point));
 						phantom_point_value = p2; //p2 needs to be held somewhere to be used as p1 of next control point
 
 						tou::glyph_outline_segment seg;
-						tou::calculate_segment_path(seg, pointsize, dpi, FLT(m_units_per_em), FLT(p1.x), FLT(p2.x), FLT(p1.y), FLT(p2.y), true, FLT(glyf.x_coords[j]), FLT(glyf.y_coords[j]));
+						tou::calculate_segment_path(seg, pointsize, dpi, FLT(m_data->units_per_em), FLT(p1.x), FLT(p2.x), FLT(p1.y), FLT(p2.y), true, FLT(x_at(j)), FLT(y_at(j)));
 						segmented_outline.push_back(seg);
 
 					}
 				}
 				else
 				{
-					if (glyf.flags_bool[j].on_curve_point && glyf.flags_bool[coord_array_position].on_curve_point)
+					if (glyf.outline.on_curve(j) && glyf.outline.on_curve(coord_array_position))
 					{
 						//////////////////////////////////////////////////////////////////////////////////////////////
 						//////////////////////////////////////////////////////////////////////////////////////////////
 						//////////////////////////////////////////////////////////////////////////////////////////////
 						tou::glyph_outline_segment seg;
-						tou::calculate_segment_path(seg, pointsize, dpi, FLT(m_units_per_em), FLT(glyf.x_coords[j]), FLT(glyf.x_coords[coord_array_position]), FLT(glyf.y_coords[j]), FLT(glyf.y_coords[coord_array_position]), false, 0.0f, 0.0f);
+						tou::calculate_segment_path(seg, pointsize, dpi, FLT(m_data->units_per_em), FLT(x_at(j)), FLT(x_at(coord_array_position)), FLT(y_at(j)), FLT(y_at(coord_array_position)), false, 0.0f, 0.0f);
 						segmented_outline.push_back(seg);
 
 					}
-					else if (!glyf.flags_bool[j].on_curve_point && glyf.flags_bool[coord_array_position].on_curve_point && phantom_point)
+					else if (!glyf.outline.on_curve(j) && glyf.outline.on_curve(coord_array_position) && phantom_point)
 					{
 						//////////////////////////////////////////////////////////////////////////////////////////////
 						//////////////////////////////////////////////////////////////////////////////////////////////
@@ -1150,7 +2693,7 @@ namespace tou
 						// use phantom point as p1, j as control, and coord_array_position as p2
 						phantom_point = false;
 						tou::glyph_outline_segment seg;
-						tou::calculate_segment_path(seg, pointsize, dpi, FLT(m_units_per_em), FLT(phantom_point_value.x), FLT(glyf.x_coords[coord_array_position]), FLT(phantom_point_value.y), FLT(glyf.y_coords[coord_array_position]), true, FLT(glyf.x_coords[j]), FLT(glyf.y_coords[j]));
+						tou::calculate_segment_path(seg, pointsize, dpi, FLT(m_data->units_per_em), FLT(phantom_point_value.x), FLT(x_at(coord_array_position)), FLT(phantom_point_value.y), FLT(y_at(coord_array_position)), true, FLT(x_at(j)), FLT(y_at(j)));
 						segmented_outline.push_back(seg);
 						
 					}
@@ -3,8 +3,19 @@
 #include <algorithm>
 #include <string>
 #include <map>
-#include <unordered_map>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <memory>
+#include <tuple>
+#include <array>
 #include "util.hpp"
+#include "cff.hpp"
+#include "outline.hpp"
+#include "variations.hpp"
+#include "sbit.hpp"
 #include "bitmap/bitmap.hpp"
 
 namespace tou
@@ -30,6 +41,38 @@ namespace tou
 			uint32_t length = 0;
 		};
 
+		// table tags are compared as the big-endian 4-byte value stored in the table record
+		constexpr uint32_t make_tag(char a, char b, char c, char d)
+		{
+			return (static_cast<uint32_t>(static_cast<uint8_t>(a)) << 24) | (static_cast<uint32_t>(static_cast<uint8_t>(b)) << 16) |
+				(static_cast<uint32_t>(static_cast<uint8_t>(c)) << 8) | static_cast<uint32_t>(static_cast<uint8_t>(d));
+		}
+
+		inline std::string tag_to_string(uint32_t tag)
+		{
+			return { static_cast<char>(tag >> 24), static_cast<char>(tag >> 16), static_cast<char>(tag >> 8), static_cast<char>(tag) };
+		}
+
+		constexpr uint32_t TAG_TTCF = make_tag('t', 't', 'c', 'f'); // TrueType collection header
+		constexpr uint32_t TAG_CFF = make_tag('C', 'F', 'F', ' ');
+		constexpr uint32_t TAG_AVAR = make_tag('a', 'v', 'a', 'r');
+		constexpr uint32_t TAG_CMAP = make_tag('c', 'm', 'a', 'p');
+		constexpr uint32_t TAG_EBDT = make_tag('E', 'B', 'D', 'T');
+		constexpr uint32_t TAG_EBLC = make_tag('E', 'B', 'L', 'C');
+		constexpr uint32_t TAG_FVAR = make_tag('f', 'v', 'a', 'r');
+		constexpr uint32_t TAG_GLYF = make_tag('g', 'l', 'y', 'f');
+		constexpr uint32_t TAG_GVAR = make_tag('g', 'v', 'a', 'r');
+		constexpr uint32_t TAG_HEAD = make_tag('h', 'e', 'a', 'd');
+		constexpr uint32_t TAG_HHEA = make_tag('h', 'h', 'e', 'a');
+		constexpr uint32_t TAG_HMTX = make_tag('h', 'm', 't', 'x');
+		constexpr uint32_t TAG_LOCA = make_tag('l', 'o', 'c', 'a');
+		constexpr uint32_t TAG_MAXP = make_tag('m', 'a', 'x', 'p');
+
+		// sfnt versions of a font with TrueType outlines, and of an OpenType font with CFF outlines
+		constexpr uint32_t SFNT_TRUETYPE = 0x00010000;
+		constexpr uint32_t SFNT_APPLE_TRUE = make_tag('t', 'r', 'u', 'e');
+		constexpr uint32_t SFNT_OTTO = make_tag('O', 'T', 'T', 'O');
+
 		struct head
 		{
 			uint16_t major_version = 0, minor_version = 0;
@@ -86,11 +129,19 @@ namespace tou
 
 		struct hmtx
 		{
-			// records are indexed by glyph id
+			// only number_of_hmetrics records, glyphs past the last one share its metrics
 			std::vector<long_hor_metric> hmetrics;
 			std::vector<int16_t> left_side_bearings;
 		};
 
+		/* loca table */
+		struct loca
+		{
+			// kept in the font's own width, only one of these is filled depending on head.index_to_loc_format
+			std::vector<uint16_t> short_offsets; // actual offset divided by two
+			std::vector<uint32_t> long_offsets;
+		};
+
 		/* hhea table */
 		struct hhea
 		{
@@ -106,16 +157,6 @@ namespace tou
 			// TO DO: hhea/OpenType font variations
 		};
 
-		struct glyph_flags
-		{
-			bool on_curve_point = false;
-			bool x_short_vector = false, y_short_vector = false;
-			bool repeat_flag = false;
-			uint8_t repeat_count = 0;
-			bool x_is_same_or_positive_x_short_vector = false, y_is_same_or_positive_y_short_vector = false;
-			bool overlap_simple = false;
-		};
-
 		struct glyph_component
 		{
 			// used for composite glyphs
@@ -195,6 +236,76 @@ namespace tou
 		uint32_t x_min = 0, x_max = 0, y_min = 0, y_max = 0;
 	};
 
+	struct font_load_options
+	{
+		// only validate the table directory on load, hmtx/loca/cmap are decoded the first time a lookup needs them
+		bool lazy_tables = false;
+
+		// don't map the whole file: the table directory and small tables are read eagerly and glyf is read on demand
+		// through a page cache holding at most page_cache_bytes, so resident memory does not depend on the file size
+		bool partial = false;
+		size_t page_cache_bytes = 256 * 1024;
+
+		// if set, the parsed table directory, loca, hmtx and cmap are saved to a sidecar file in this directory
+		// (keyed by the font's path, size and modification time) and later loads map it instead of parsing the font again
+		std::string cache_directory;
+
+		// face to load from a TrueType collection (.ttc), must be 0 for single font files
+		uint32_t face_index = 0;
+
+		// check that every table in the directory lies within the file and matches its checksum, the load fails otherwise
+		// this reads the whole font once, including glyf
+		bool validate = false;
+
+		// expand the cmap once into a table holding the glyph id of every BMP codepoint (128 KiB), so mapping a codepoint
+		// is a single load instead of a search through the cmap segments, lazy mode builds it on the first lookup
+		// fonts with a full Unicode cmap (format 12 or 13) are always looked up through its page table, the option has no effect then
+		bool dense_cmap = false;
+	};
+
+	// a TrueType collection (.ttc) opened once, a plain font file is treated as a collection of one face
+	// faces loaded from it share its byte source and every decoded table they have in common
+	class font_collection
+	{
+	public:
+		font_collection();
+		font_collection(const std::string& filepath, const tou::font_load_options& options = {});
+		~font_collection() = default;
+
+		// only the partial and page_cache_bytes options apply to the collection itself
+		bool load(const std::string& filepath, const tou::font_load_options& options = {});
+		bool load(const tou::font_collection& collection, uint32_t face_index, const tou::font_load_options& options = {});
+
+		uint32_t face_count() const { return m_num_faces; }
+		bool ok() const { return m_ok; }
+		explicit operator bool() const { return m_ok; }
+
+	private:
+		friend class font_face;
+
+		// decoded tables keyed by where they live in the file
+		struct shared_tables
+		{
+			struct key
+			{
+				uint32_t tag = 0, offset = 0, length = 0, variant = 0;
+				bool operator<(const key& rhs) const { return std::tie(tag, offset, length, variant) < std::tie(rhs.tag, rhs.offset, rhs.length, rhs.variant); }
+			};
+
+			std::shared_ptr<const void> get(const key& k, const std::function<std::shared_ptr<const void>()>& decode);
+
+			std::mutex mutex;
+			std::map<key, std::shared_ptr<const void>> tables;
+		};
+
+	private:
+		tou::vector_reader							m_reader;
+		std::string									m_filepath;
+		std::shared_ptr<font_collection::shared_tables>	m_shared_tables;
+		bool										m_ok;
+		uint32_t									m_num_faces;
+	};
+
 	class font_face
 	{
 	public:
@@ -204,14 +315,14 @@ namespace tou
 			uint16_t id = 0;
 			int16_t x_min = 0, y_min = 0, x_max = 0, y_max = 0;
 			int16_t num_contours = 0; // -1 is for composite glyphs
-			std::vector<uint16_t> end_pts_of_contours;	
 			uint16_t num_points = 0;
 			uint16_t instruction_len = 0;
 			std::vector<uint8_t> instructions;
 			uint16_t advance_width = 0;
 			int16_t left_side_bearing = 0;
-			std::vector<truetype::glyph_flags> flags_bool;
-			std::vector<int16_t> x_coords, y_coords;
+			tou::outline::packed outline; // points, their flags and the contour ends
+			uint16_t component_depth = 0; // how deep the components of a composite nest, 0 for simple glyphs
+			bool components_left_out = false; // components nesting too deep or referring back to the glyph are not part of the outline
 		};
 
 		struct bitmap_glyph
@@ -222,45 +333,256 @@ namespace tou
 			tou::bitmap_image image;
 		};
 
+		// codepoints first through last all map to a glyph
+		struct codepoint_range
+		{
+			uint32_t first = 0, last = 0;
+		};
+
 	public:
 		font_face();
-		font_face(const std::string& filepath);
+		font_face(const std::string& filepath, const tou::font_load_options& options = {});
+		font_face(const tou::font_collection& collection, uint32_t face_index, const tou::font_load_options& options = {});
 		~font_face();
 
-		bool load(const std::string& filepath);
-		const font_face::truetype_glyph& get_glyph(uint16_t unicode);
-		font_face::bitmap_glyph get_glyph_bitmap(uint16_t unicode, float pointsize, bool render_outline, bool render_inside);
+		// faces are handles on parsed font data shared with every other face opened on the same font,
+		// a copy shares that data, keeps the selected variation instance and starts with an empty glyph cache of its own
+		font_face(const font_face& other);
+		font_face& operator=(const font_face& other);
+		font_face(font_face&&) = default;
+		font_face& operator=(font_face&&) = default;
+
+		// loading a font that another live face already opened with the same options reuses its parsed data
+		bool load(const std::string& filepath, const tou::font_load_options& options = {});
+		bool load(const tou::font_collection& collection, uint32_t face_index, const tou::font_load_options& options = {});
+		// both can be called from several threads at once, the returned glyph reference stays valid for the lifetime of the face,
+		// or with a glyph cache limit set until the calling thread's next get_glyph call
+		// codepoints above U+FFFF are only mapped by fonts with a format 12 or 13 cmap
+		const font_face::truetype_glyph& get_glyph(uint32_t unicode);
+		// glyphs the font has an embedded bitmap for at this size are drawn from it as is, the others are rasterized from their outline
+		font_face::bitmap_glyph get_glyph_bitmap(uint32_t unicode, float pointsize, bool render_outline, bool render_inside);
+
+		// maps a whole string to glyph ids in one pass, glyph_ids receives 'count' ids with 0 for codepoints the font doesn't map
+		// Latin-1 comes from a table and ascending runs walk the cmap segments once, nothing is logged or cached, safe to call from several threads
+		void map_codepoints(const char32_t* codepoints, size_t count, uint16_t* glyph_ids);
+
+		// coverage is built from the cmap on first use and shared with the other faces of the font, it reads no glyph data and logs nothing
+		bool has_glyph(uint32_t unicode);
+		// how many of the codepoints map to a glyph
+		size_t count_covered(const char32_t* codepoints, size_t count);
+		// every mapped codepoint as ascending, non-adjacent ranges
+		const std::vector<font_face::codepoint_range>& get_coverage();
+
+		// axes of a variable font, empty for static fonts
+		const std::vector<tou::variations::axis>& get_variation_axes() const;
+		// selects the instance later get_glyph calls return, as (axis tag, user value) pairs, axes left out stay at their default
+		// outlines are cached per glyph and instance, so switching back to an instance used before doesn't apply its deltas again
+		// lookups already running on other threads finish at the instance they started with
+		bool set_variation(const std::vector<std::pair<uint32_t, float>>& coordinates);
+
+		// keeps at most 'glyphs' decoded outlines in this face's cache (0, the default, keeps every one), the oldest are dropped first
+		// a reference returned by get_glyph then stays valid until the same thread calls get_glyph again, on this face or another
+		// one, references returned before the limit was set are only valid until it is
+		void set_glyph_cache_limit(size_t glyphs);
+
+		// decodes the outlines of glyph ids [first_glyph, last_glyph], or of every glyph, at the current instance into the cache
+		// on 'threads' threads counting the caller (0 uses every core), glyphs already cached are skipped
+		// with a cache limit set only the last outlines decoded stay cached
+		void preload(uint16_t first_glyph, uint16_t last_glyph, unsigned threads = 0);
+		void preload(unsigned threads = 0);
 		
 		bool ok() const { return m_ok; }
 		explicit operator bool() const { return m_ok; }
 
 	private:
+		struct unicode_coverage;
+		struct glyph_cache;
+
+		// the composites being decoded above a component, outermost first
+		// nesting stops at maxp's depth and never goes past MAX_COMPONENT_DEPTH whatever maxp claims
+		static constexpr uint16_t MAX_COMPONENT_DEPTH = 8;
+		struct component_path
+		{
+			std::array<uint16_t, MAX_COMPONENT_DEPTH> glyph_ids{};
+			uint16_t depth = 0;
+		};
+
 		bool m_parse_truetype_file(const std::string& filepath);
+		bool m_validate_tables();
+		template <typename T>
+		std::shared_ptr<const T> m_decode_table(const truetype::table_record& record, uint32_t variant, const std::function<T()>& decode);
+		void m_parse_hmtx();
+		void m_parse_loca();
+		bool m_parse_cmap();
+		void m_finish_cmap();
+		void m_parse_cmap_groups();
+		void m_expand_cmap();
+		bool m_parse_cff();
+		void m_parse_variations();
+		void m_parse_bitmap_strikes();
 		
-		uint16_t m_get_truetype_glyph_id(uint16_t unicode);
-		bool m_get_truetype_simple_glyph_header_data(font_face::truetype_glyph& glyph);
-		void m_get_truetype_simple_glyph_data(font_face::truetype_glyph& glyph);
-		void m_get_truetype_component_glyph_data(std::vector<truetype::glyph_component>& components);
-		void m_get_truetype_glyph_data_by_id(font_face::truetype_glyph& glyph, uint16_t glyph_id);
-		void m_get_truetype_glyph_data_by_id(font_face::truetype_glyph& glyph, uint16_t glyph_id, std::vector<truetype::glyph_component>& components);
+		std::string m_sidecar_path(const std::string& absolute_path) const;
+		bool m_load_sidecar(const std::string& filepath);
+		void m_write_sidecar(const std::string& filepath) const;
+
+		const truetype::table_record* m_find_table(uint32_t tag) const;
+		void m_ensure_cmap_parsed();
+		uint16_t m_get_truetype_glyph_id(tou::vector_reader& reader, uint32_t unicode);
+		uint16_t m_find_glyph_id(tou::vector_reader& reader, uint32_t unicode);
+		uint16_t m_get_format4_glyph_id(tou::vector_reader& reader, uint64_t i, uint16_t unicode);
+		const font_face::unicode_coverage& m_get_coverage();
+		uint32_t m_get_loca_offset(tou::vector_reader& reader, uint16_t glyph_id);
+		truetype::long_hor_metric m_get_hmetric(tou::vector_reader& reader, uint16_t glyph_id);
+		bool m_get_truetype_simple_glyph_header_data(tou::vector_reader& reader, font_face::truetype_glyph& glyph);
+		void m_get_truetype_simple_glyph_data(tou::vector_reader& reader, font_face::truetype_glyph& glyph);
+		void m_get_truetype_component_glyph_data(tou::vector_reader& reader, std::vector<truetype::glyph_component>& components);
+		void m_get_truetype_glyph_data_by_id(tou::vector_reader& reader, font_face::truetype_glyph& glyph, uint16_t glyph_id, std::vector<truetype::glyph_component>& components);
+		void m_get_cff_glyph_data(tou::vector_reader& reader, font_face::truetype_glyph& glyph);
+		void m_apply_glyph_variations(tou::vector_reader& reader, font_face::truetype_glyph& glyph, const std::vector<int16_t>& coordinates);
+		// moves the component offsets and sets the advance, returns where the instance puts the glyph origin
+		int16_t m_apply_component_variations(tou::vector_reader& reader, font_face::truetype_glyph& glyph, std::vector<truetype::glyph_component>& components, const std::vector<int16_t>& coordinates);
 		
-		font_face::truetype_glyph m_get_truetype_glyph(uint16_t unicode);
+		// 'path' holds the composites above the glyph, components nested deeper than maxp allows or already on the path are left out
+		font_face::truetype_glyph m_get_truetype_glyph(tou::vector_reader& reader, uint16_t glyph_id, font_face::glyph_cache& instance, const font_face::component_path& path);
+		// the cached outline of the glyph 'unicode' maps to, decoding it on a miss
+		// 'owner' is given a reference on the outline when set, get_glyph leaves it out so a hit touches no count shared between threads
+		const font_face::truetype_glyph& m_get_cached_glyph(uint32_t unicode, std::shared_ptr<const font_face::truetype_glyph>* owner);
+		// the cached outline of a glyph at 'instance', decoding it on a miss, composites get their components through here
+		std::shared_ptr<const font_face::truetype_glyph> m_get_cached_glyph_by_id(tou::vector_reader& reader, uint16_t glyph_id, font_face::glyph_cache& instance, const font_face::component_path& path);
 		
+		bool m_draw_embedded_bitmap(uint32_t unicode, float pointsize, font_face::bitmap_glyph& out);
 		font_face::bitmap_glyph m_rasterize_truetype_glyph(const font_face::truetype_glyph& g, float pointsize, bool render_outline, bool render_inside);
 
 	private:
-		tou::vector_reader													m_reader;
-		std::unordered_map<std::string, tou::truetype::table_record>		m_table_records;
-		std::pair<tou::truetype::cmap_header, tou::truetype::cmap_format4>	m_cmap;
-		tou::truetype::hmtx													m_hmtx;
-		std::vector<uint32_t>												m_loca_offset32;
-		std::map<uint16_t, font_face::truetype_glyph>						m_glyphs; // only contains glyphs queried for by user
-		
-		bool		m_ok;
-		uint32_t	m_sfnt;
-		uint16_t	m_num_glyphs;
-		uint16_t	m_units_per_em;
-		uint16_t	m_seg_count;
-		uint64_t	m_id_range_offset_from_filestart;
+		struct parsed_cmap
+		{
+			tou::truetype::cmap_header header;
+			tou::truetype::cmap_format4 format4;
+			uint64_t id_range_offset_from_filestart = 0; // file position of the format 4 idRangeOffset array
+			bool format4_exists = false;
+		};
+
+		// views used for lookups, they point either into the parsed tables below or into the sidecar mapping
+		struct cmap_format4_lookup
+		{
+			tou::array_view<uint16_t> end_code;
+			tou::array_view<uint16_t> start_code;
+			tou::array_view<int16_t> id_delta;
+			tou::array_view<uint16_t> id_range_offset;
+		};
+
+		// a format 12 or 13 cmap expanded into pages of 256 codepoints, pages without a mapped codepoint all point at page 0
+		struct cmap_page_table
+		{
+			std::vector<uint16_t> pages;		// page of each block of 256 codepoints up to U+10FFFF
+			std::vector<uint16_t> glyph_ids;	// 256 glyph ids per page, page 0 is all zeros
+		};
+
+		// the codepoints a cmap maps to a glyph, as a bitset for the BMP and ranges for everything
+		struct unicode_coverage
+		{
+			std::vector<uint64_t> bmp_bits; // bit (c & 63) of word c / 64 is set when c is mapped
+			std::vector<font_face::codepoint_range> ranges;
+		};
+
+		// the parsed font, immutable once loaded apart from cmap, which lazy mode parses once on the first lookup
+		struct face_data
+		{
+			tou::vector_reader									reader; // only positioned while loading, lookups read through copies
+			std::vector<tou::truetype::table_record>			table_records; // sorted by tag
+			tou::truetype::table_record							glyf_table;
+			tou::truetype::table_record							loca_table;
+			tou::truetype::table_record							hmtx_table;
+			tou::truetype::table_record							cmap_table;
+			std::shared_ptr<font_collection::shared_tables>		shared_tables; // set when loaded from a collection
+			std::shared_ptr<const font_face::parsed_cmap>		cmap;
+			std::shared_ptr<const tou::truetype::hmtx>			hmtx;
+			std::shared_ptr<const tou::truetype::loca>			loca;
+			std::shared_ptr<const tou::cff::font>				cff; // set instead of glyf/loca for fonts with CFF outlines
+			std::shared_ptr<const tou::variations::font>		variations; // set for variable fonts with glyf outlines
+			std::shared_ptr<const tou::sbit::font>				bitmap_strikes; // set for fonts with embedded bitmaps
+			tou::array_view<uint16_t>							loca_short;
+			tou::array_view<uint32_t>							loca_long;
+			tou::array_view<truetype::long_hor_metric>			hmetrics;
+			font_face::cmap_format4_lookup						cmap_lookup;
+			std::shared_ptr<const std::vector<uint16_t>>		bmp_glyph_table; // set with options.dense_cmap
+			tou::array_view<uint16_t>							bmp_glyph_ids; // indexed by codepoint, empty unless dense_cmap is set
+			std::shared_ptr<const font_face::cmap_page_table>	cmap_pages_table; // set for fonts with a format 12 or 13 cmap
+			tou::array_view<uint16_t>							cmap_pages;
+			tou::array_view<uint16_t>							cmap_page_glyph_ids;
+			std::array<uint16_t, 256>							latin1_glyph_ids{}; // built with the cmap lookup structures
+			std::shared_ptr<const font_face::unicode_coverage>	coverage; // built on first use
+			std::shared_ptr<const tou::file_mapping>			sidecar;
+			tou::font_load_options								options;
+
+			std::mutex			cmap_mutex; // also guards building coverage
+			std::atomic<bool>	cmap_parsed{ false };
+			std::atomic<bool>	coverage_built{ false };
+
+			uint32_t	sfnt = truetype::SFNT_TRUETYPE;
+			uint16_t	num_glyphs = 0;
+			uint16_t	max_component_depth = 0;
+			uint16_t	num_hori_metrics = 0;
+			uint16_t	units_per_em = 0;
+			int16_t		index_to_loc_format = 0;
+			uint16_t	seg_count = 0;
+			uint64_t	id_range_offset_from_filestart = 0;
+		};
+
+		// the outlines decoded at one variation instance, in pages of 256 glyph ids allocated as they are first used
+		// a cache hit reads the published pointer without locking, both arrays are written under the glyph's shard lock
+		struct glyph_cache
+		{
+			struct page
+			{
+				std::array<std::atomic<const font_face::truetype_glyph*>, 256> glyphs{};
+				// the owners are shared pointers so a glyph being rasterized outlives its eviction
+				std::array<std::shared_ptr<const font_face::truetype_glyph>, 256> owners;
+			};
+
+			std::vector<int16_t> coordinates; // normalized, empty for the default instance
+			std::array<std::atomic<page*>, 256> pages{};
+
+			explicit glyph_cache(const std::vector<int16_t>& instance_coordinates);
+			~glyph_cache();
+			const font_face::truetype_glyph* find(uint16_t glyph_id) const;
+			page& page_of(uint16_t glyph_id);
+		};
+
+		// what get_glyph mutates, owned by each face
+		struct lookup_state
+		{
+			// outlines are added and evicted under the lock of their glyph id's shard, so decodes finishing on several threads
+			// seldom wait on each other, a hit only takes one when it wants a reference on the outline
+			static constexpr uint32_t SHARDS = 32;
+			struct alignas(64) shard
+			{
+				std::shared_mutex mutex;
+			};
+			std::array<shard, SHARDS> shards;
+
+			// guards the members below, taken when an outline is added or the instance changes but never by a cache hit
+			std::mutex mutex;
+			std::deque<std::pair<font_face::glyph_cache*, uint16_t>> cached; // every cached outline, oldest first
+			std::atomic<size_t> cache_limit{ 0 }; // 0 keeps every outline, read without the lock by cache hits
+			std::vector<std::unique_ptr<font_face::glyph_cache>> instances; // every instance selected so far, the default first
+			std::atomic<font_face::glyph_cache*> instance; // the current one
+
+			lookup_state();
+			shard& shard_of(uint16_t glyph_id) { return shards[glyph_id % SHARDS]; }
+			// makes the instance at 'coordinates' current, adding it if it wasn't used before, callers hold mutex
+			void select_instance(const std::vector<int16_t>& coordinates);
+			// the cached outline with a reference on it, takes the glyph's shard lock shared
+			std::shared_ptr<const font_face::truetype_glyph> find_glyph(font_face::glyph_cache& cache, uint16_t glyph_id);
+			// takes the locks it needs, if another thread added the glyph first that outline is returned and 'glyph' dropped
+			std::shared_ptr<const font_face::truetype_glyph> add_glyph(font_face::glyph_cache& cache, uint16_t glyph_id, font_face::truetype_glyph&& glyph);
+			// callers hold mutex
+			void evict(size_t limit);
+		};
+
+	private:
+		std::shared_ptr<font_face::face_data>								m_data;
+		std::unique_ptr<font_face::lookup_state>							m_lookup;
+		bool																m_ok;
 	};
 }
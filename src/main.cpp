@@ -1,6 +1,8 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <cstdlib>
 
 #include <argparse/argparse.hpp>
 
@@ -15,11 +17,19 @@ int main(int argc, char** argv)
     const std::string arg_unicode = "unicode";
     const std::string arg_pointsize = "pointsize";
     const std::string arg_output = "output";
+    const std::string arg_cache_dir = "cache-dir";
+    const std::string arg_face = "face";
+    const std::string arg_validate = "validate";
+    const std::string arg_axis = "axis";
 
     program.add_argument(arg_fontpath).help("Path to a truetype font file.");
     program.add_argument(arg_unicode).help("Decimal representation of desired glyph's unicode codepoint.").default_value(65).scan<'i', int>();
     program.add_argument("-p", "--" + arg_pointsize).help("If writing a bitmap, this is the integer value denoting the pointsize to return the glyph as.").default_value(12).scan<'i', int>();
     program.add_argument("-o", "--" + arg_output).help("Write the glyph bitmap to a given path.");
+    program.add_argument("-f", "--" + arg_face).help("Index of the face to use when the font file is a TrueType collection (.ttc).").default_value(0).scan<'i', int>();
+    program.add_argument("-c", "--" + arg_cache_dir).help("Directory where pre-parsed font data is kept between runs to speed up loading.");
+    program.add_argument("-v", "--" + arg_validate).help("Verify the table checksums of the font file before using it.").flag();
+    program.add_argument("-a", "--" + arg_axis).help("Variation axis value for variable fonts given as tag=value (e.g. wght=700), can be repeated.").append();
 
     try
     {
@@ -35,6 +45,7 @@ int main(int argc, char** argv)
     std::string font_path = program.get<std::string>(arg_fontpath);
     int codepoint = program.get<int>(arg_unicode);
     int pointsize = program.get<int>(arg_pointsize);
+    int face_index = program.get<int>(arg_face);
     
     std::string out_path;
     if(program.present("-o"))
@@ -43,14 +54,19 @@ int main(int argc, char** argv)
     }
 
     std::string type = font_path.substr(font_path.size() - 4);
-    if (type != ".ttf" && type != ".otf")
+    if (type != ".ttf" && type != ".otf" && type != ".ttc")
     {
         std::cout << "The provided font file with type " << type << " does not seem to be a TrueType or OpenType font file\n";
         return EXIT_FAILURE;
     }
-    if (codepoint < 0 || codepoint > 0xFFFF)
+    if (face_index < 0)
+    {
+        std::cout << "The face index must not be negative\n";
+        return EXIT_FAILURE;
+    }
+    if (codepoint < 0 || codepoint > 0x10FFFF)
 	{
-		std::cout << "The unicode codepoint given is not valid or exists outside the 16-bit standard unicode range.\nPlease provide a decimal value between 0 and 65,535\n";
+		std::cout << "The unicode codepoint given is not valid or exists outside the unicode range.\nPlease provide a decimal value between 0 and 1,114,111\n";
 		return EXIT_FAILURE;
 	}
     if (pointsize < 0 || pointsize > 102.0f) // arbitrary limit of 102...
@@ -59,17 +75,47 @@ int main(int argc, char** argv)
 		return EXIT_FAILURE;
 	}
 
-    tou::font_face face(font_path);
+    // only a single glyph is needed, so skip decoding whole tables up front
+    // unless they are cached, in which case the first run parses everything once and later runs map the cache file
+    tou::font_load_options options;
+    options.lazy_tables = true;
+    options.face_index = static_cast<uint32_t>(face_index);
+    options.validate = program.get<bool>(arg_validate);
+    if (program.present("-c"))
+    {
+        options.cache_directory = program.get<std::string>(arg_cache_dir);
+        options.lazy_tables = false;
+    }
+    tou::font_face face(font_path, options);
     if (!face)
     {
-        std::cout << "The font file could not be loaded. Please verify that the given file is a valid truetype (.ttf) or opentype (.otf) font file\n";
+        std::cout << "The font file could not be loaded. Please verify that the given file is a valid truetype (.ttf/.ttc) or opentype (.otf) font file\n";
 		return EXIT_FAILURE;
     }
 
+    std::vector<std::pair<uint32_t, float>> variation;
+    for (const std::string& axis : program.get<std::vector<std::string>>(arg_axis))
+    {
+        size_t separator = axis.find('=');
+        std::string tag = axis.substr(0, separator);
+        if (separator == std::string::npos || tag.empty() || tag.size() > 4)
+        {
+            std::cout << "The variation axis " << axis << " is not given as tag=value\n";
+            return EXIT_FAILURE;
+        }
+        tag.resize(4, ' ');
+        variation.emplace_back(tou::truetype::make_tag(tag[0], tag[1], tag[2], tag[3]), std::strtof(axis.c_str() + separator + 1, nullptr));
+    }
+    if (!face.set_variation(variation))
+    {
+        std::cout << "The requested variation axes are not supported by this font file\n";
+        return EXIT_FAILURE;
+    }
+
 
     if (!out_path.empty())
     {
-        tou::font_face::bitmap_glyph glyph = face.get_glyph_bitmap(static_cast<uint16_t>(codepoint), pointsize, true, true);
+        tou::font_face::bitmap_glyph glyph = face.get_glyph_bitmap(static_cast<uint32_t>(codepoint), pointsize, true, true);
         std::string filename = "glyph" + std::to_string(codepoint) + "@" + std::to_string(static_cast<int>(pointsize)) + "pt.bmp";
 	    if (out_path.length() > 0)
 	    {
@@ -88,7 +134,7 @@ int main(int argc, char** argv)
     }
     else
     {
-        tou::font_face::truetype_glyph glyph = face.get_glyph(codepoint);
+        tou::font_face::truetype_glyph glyph = face.get_glyph(static_cast<uint32_t>(codepoint));
         std::cout << "glyph metrics:\n";
         std::cout << "id: " << glyph.id << "\n";
         std::cout << "x_min, ymin: " << glyph.x_min << ", " << glyph.y_min << "\n";
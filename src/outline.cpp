@@ -0,0 +1,56 @@
+#include "outline.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace tou
+{
+	namespace outline
+	{
+		void packed::resize(uint16_t num_points, uint16_t num_contours)
+		{
+			// flags take half an int16 per point, rounded up
+			m_num_points = num_points;
+			m_num_contours = num_contours;
+			m_block.assign(2 * (size_t)num_points + num_contours + ((size_t)num_points + 1) / 2, 0);
+			std::memset(flags(), ON_CURVE, num_points);
+		}
+
+		bool packed::append(const packed& other, int16_t dx, int16_t dy)
+		{
+			const size_t points = (size_t)m_num_points + other.m_num_points;
+			const size_t contours = (size_t)m_num_contours + other.m_num_contours;
+			if (points > UINT16_MAX || contours > UINT16_MAX)
+				return false;
+
+			packed merged;
+			merged.resize(static_cast<uint16_t>(points), static_cast<uint16_t>(contours));
+			std::copy(x(), x() + m_num_points, merged.x());
+			std::copy(y(), y() + m_num_points, merged.y());
+			std::copy(end_points(), end_points() + m_num_contours, merged.end_points());
+			std::copy(flags(), flags() + m_num_points, merged.flags());
+			for (uint16_t i = 0; i < other.m_num_points; i++)
+			{
+				merged.x()[m_num_points + i] = static_cast<int16_t>(other.x()[i] + dx);
+				merged.y()[m_num_points + i] = static_cast<int16_t>(other.y()[i] + dy);
+			}
+			for (uint16_t i = 0; i < other.m_num_contours; i++)
+				merged.end_points()[m_num_contours + i] = static_cast<uint16_t>(other.end_points()[i] + m_num_points);
+			std::copy(other.flags(), other.flags() + other.m_num_points, merged.flags() + m_num_points);
+			*this = std::move(merged);
+			return true;
+		}
+
+		bool packed::bounds(int16_t& x_min, int16_t& y_min, int16_t& x_max, int16_t& y_max) const
+		{
+			if (m_num_points == 0)
+				return false;
+			auto xs = std::minmax_element(x(), x() + m_num_points);
+			auto ys = std::minmax_element(y(), y() + m_num_points);
+			x_min = *xs.first;
+			x_max = *xs.second;
+			y_min = *ys.first;
+			y_max = *ys.second;
+			return true;
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tou
+{
+	namespace outline
+	{
+		// bits of a point's flag byte, they keep their glyf table values
+		constexpr uint8_t ON_CURVE = 0x01;
+		constexpr uint8_t OVERLAP = 0x40;
+
+		// a glyph outline in a single allocation, x coordinates then y coordinates, the last point of each contour, then a flag byte per point
+		class packed
+		{
+		public:
+			// coordinates and contour ends start at 0, flags at ON_CURVE
+			void resize(uint16_t num_points, uint16_t num_contours);
+			void clear() { resize(0, 0); }
+			// adds the contours of 'other' after these ones with its points moved by (dx, dy), fails past 65535 points or contours
+			bool append(const packed& other, int16_t dx, int16_t dy);
+			// the box around every point, false for an empty outline
+			bool bounds(int16_t& x_min, int16_t& y_min, int16_t& x_max, int16_t& y_max) const;
+
+			uint16_t num_points() const { return m_num_points; }
+			uint16_t num_contours() const { return m_num_contours; }
+
+			int16_t* x() { return m_block.data(); }
+			int16_t* y() { return m_block.data() + m_num_points; }
+			uint16_t* end_points() { return reinterpret_cast<uint16_t*>(m_block.data() + 2 * (size_t)m_num_points); }
+			uint8_t* flags() { return reinterpret_cast<uint8_t*>(m_block.data() + 2 * (size_t)m_num_points + m_num_contours); }
+			const int16_t* x() const { return m_block.data(); }
+			const int16_t* y() const { return m_block.data() + m_num_points; }
+			const uint16_t* end_points() const { return reinterpret_cast<const uint16_t*>(m_block.data() + 2 * (size_t)m_num_points); }
+			const uint8_t* flags() const { return reinterpret_cast<const uint8_t*>(m_block.data() + 2 * (size_t)m_num_points + m_num_contours); }
+
+			bool on_curve(size_t point) const { return (flags()[point] & ON_CURVE) != 0; }
+
+		private:
+			std::vector<int16_t> m_block;
+			uint16_t m_num_points = 0, m_num_contours = 0;
+		};
+	}
+}
@@ -0,0 +1,263 @@
+#include "sbit.hpp"
+#include <algorithm>
+
+namespace tou
+{
+	namespace sbit
+	{
+		namespace
+		{
+			constexpr uint32_t BITMAP_SIZE_RECORD_SIZE = 48;
+			constexpr uint32_t BIG_METRICS_SIZE = 8;
+			constexpr uint32_t SMALL_METRICS_SIZE = 5;
+
+			// where a glyph's image lies in EBDT, and its metrics when the index subtable holds them for every glyph
+			struct image_location
+			{
+				uint16_t image_format = 0;
+				uint64_t offset = 0, length = 0;
+				bool has_metrics = false;
+				glyph metrics;
+			};
+
+			void read_big_metrics(tou::vector_reader& reader, glyph& out)
+			{
+				out.height = reader.get_uint8();
+				out.width = reader.get_uint8();
+				out.bearing_x = static_cast<int8_t>(reader.get_uint8());
+				out.bearing_y = static_cast<int8_t>(reader.get_uint8());
+				out.advance = reader.get_uint8();
+				reader.increment_position(3); // vertical metrics
+			}
+
+			void read_small_metrics(tou::vector_reader& reader, glyph& out)
+			{
+				out.height = reader.get_uint8();
+				out.width = reader.get_uint8();
+				out.bearing_x = static_cast<int8_t>(reader.get_uint8());
+				out.bearing_y = static_cast<int8_t>(reader.get_uint8());
+				out.advance = reader.get_uint8();
+			}
+
+			bool locate_image(tou::vector_reader& reader, const font& f, const index_subtable& subtable, uint16_t glyph_id, image_location& out)
+			{
+				const uint64_t location_end = f.location_offset + f.location_length;
+				if (subtable.header + 8 > location_end)
+					return false;
+
+				reader.set_position(subtable.header);
+				uint16_t index_format = reader.get_uint16();
+				out.image_format = reader.get_uint16();
+				uint64_t image_data = f.data_offset + reader.get_uint32();
+				uint32_t i = glyph_id - subtable.first_glyph;
+				uint64_t start = 0, end = 0;
+
+				switch (index_format)
+				{
+				case 1: // uint32 offsets for every glyph of the range
+				case 3: // uint16 offsets
+				{
+					uint32_t width = index_format == 1 ? 4 : 2;
+					if (subtable.header + 8 + ((uint64_t)i + 2) * width > location_end)
+						return false;
+					reader.set_position(subtable.header + 8 + (uint64_t)i * width);
+					start = index_format == 1 ? reader.get_uint32() : reader.get_uint16();
+					end = index_format == 1 ? reader.get_uint32() : reader.get_uint16();
+					break;
+				}
+				case 2: // every glyph of the range has the same size and metrics
+				{
+					if (subtable.header + 12 + BIG_METRICS_SIZE > location_end)
+						return false;
+					uint32_t image_size = reader.get_uint32();
+					read_big_metrics(reader, out.metrics);
+					out.has_metrics = true;
+					start = (uint64_t)image_size * i;
+					end = start + image_size;
+					break;
+				}
+				case 4: // sparse (glyph id, uint16 offset) pairs sorted by glyph id, plus one pair ending the last image
+				{
+					if (subtable.header + 12 > location_end)
+						return false;
+					uint32_t count = reader.get_uint32();
+					if (subtable.header + 12 + ((uint64_t)count + 1) * 4 > location_end)
+						return false;
+					uint32_t low = 0, high = count;
+					while (low < high)
+					{
+						uint32_t mid = low + (high - low) / 2;
+						reader.set_position(subtable.header + 12 + (uint64_t)mid * 4);
+						if (reader.get_uint16() < glyph_id)
+							low = mid + 1;
+						else
+							high = mid;
+					}
+					reader.set_position(subtable.header + 12 + (uint64_t)low * 4);
+					if (low == count || reader.get_uint16() != glyph_id)
+						return false;
+					start = reader.get_uint16();
+					reader.increment_position(2);
+					end = reader.get_uint16();
+					break;
+				}
+				case 5: // sparse sorted glyph ids sharing one size and metrics
+				{
+					if (subtable.header + 16 + BIG_METRICS_SIZE > location_end)
+						return false;
+					uint32_t image_size = reader.get_uint32();
+					read_big_metrics(reader, out.metrics);
+					out.has_metrics = true;
+					uint32_t count = reader.get_uint32();
+					uint64_t ids = reader.get_position();
+					if (ids + (uint64_t)count * 2 > location_end)
+						return false;
+					uint32_t low = 0, high = count;
+					while (low < high)
+					{
+						uint32_t mid = low + (high - low) / 2;
+						reader.set_position(ids + (uint64_t)mid * 2);
+						if (reader.get_uint16() < glyph_id)
+							low = mid + 1;
+						else
+							high = mid;
+					}
+					reader.set_position(ids + (uint64_t)low * 2);
+					if (low == count || reader.get_uint16() != glyph_id)
+						return false;
+					start = (uint64_t)image_size * low;
+					end = start + image_size;
+					break;
+				}
+				default:
+					return false;
+				}
+
+				// an empty range means the strike doesn't draw this glyph
+				out.offset = image_data + start;
+				out.length = end - start;
+				return end > start && out.offset + out.length <= f.data_offset + f.data_length;
+			}
+		}
+
+		bool parse_font(tou::vector_reader& reader, uint64_t location_offset, uint64_t location_length, uint64_t data_offset, uint64_t data_length,
+			uint16_t num_glyphs, font& out)
+		{
+			out = {};
+			out.location_offset = location_offset;
+			out.location_length = location_length;
+			out.data_offset = data_offset;
+			out.data_length = data_length;
+			if (location_length < 8 || data_length < 4)
+				return false;
+
+			reader.set_position(location_offset);
+			if (reader.get_uint16() != 2)
+				return false;
+			reader.increment_position(2);
+			uint32_t num_sizes = reader.get_uint32();
+			if (8 + (uint64_t)num_sizes * BITMAP_SIZE_RECORD_SIZE > location_length)
+				return false;
+
+			for (uint32_t i = 0; i < num_sizes; i++)
+			{
+				uint64_t record = location_offset + 8 + (uint64_t)i * BITMAP_SIZE_RECORD_SIZE;
+				reader.set_position(record);
+				uint32_t array_offset = reader.get_uint32();
+				reader.increment_position(4);
+				uint32_t num_subtables = reader.get_uint32();
+				reader.set_position(record + 44);
+				strike s;
+				s.ppem_x = reader.get_uint8();
+				s.ppem_y = reader.get_uint8();
+				s.bit_depth = reader.get_uint8();
+				if (s.bit_depth != 1 && s.bit_depth != 2 && s.bit_depth != 4 && s.bit_depth != 8)
+					continue;
+				if ((uint64_t)array_offset + (uint64_t)num_subtables * 8 > location_length)
+					return false;
+
+				reader.set_position(location_offset + array_offset);
+				s.subtables.reserve(num_subtables);
+				for (uint32_t j = 0; j < num_subtables; j++)
+				{
+					index_subtable subtable;
+					subtable.first_glyph = reader.get_uint16();
+					subtable.last_glyph = reader.get_uint16();
+					subtable.header = location_offset + array_offset + reader.get_uint32();
+					if (subtable.first_glyph <= subtable.last_glyph && subtable.last_glyph < num_glyphs)
+						s.subtables.push_back(subtable);
+				}
+				std::sort(s.subtables.begin(), s.subtables.end(),
+					[](const index_subtable& a, const index_subtable& b) { return a.first_glyph < b.first_glyph; });
+				out.strikes.push_back(std::move(s));
+			}
+			return true;
+		}
+
+		const strike* find_strike(const font& f, uint16_t ppem)
+		{
+			for (const strike& s : f.strikes)
+			{
+				if (s.ppem_x == ppem && s.ppem_y == ppem)
+					return &s;
+			}
+			return nullptr;
+		}
+
+		bool decode_glyph(const tou::vector_reader& reader, const font& f, const strike& s, uint16_t glyph_id, glyph& out)
+		{
+			auto it = std::upper_bound(s.subtables.begin(), s.subtables.end(), glyph_id,
+				[](uint16_t id, const index_subtable& subtable) { return id < subtable.first_glyph; });
+			if (it == s.subtables.begin() || glyph_id > (it - 1)->last_glyph)
+				return false;
+
+			tou::vector_reader r = reader;
+			image_location location;
+			if (!locate_image(r, f, *(it - 1), glyph_id, location))
+				return false;
+
+			// formats 1 and 6 pad each row to a byte, 2, 5 and 7 pack rows back to back
+			bool byte_aligned = false;
+			uint32_t metrics_size = 0;
+			r.set_position(location.offset);
+			switch (location.image_format)
+			{
+			case 1: byte_aligned = true; metrics_size = SMALL_METRICS_SIZE; read_small_metrics(r, out); break;
+			case 2: metrics_size = SMALL_METRICS_SIZE; read_small_metrics(r, out); break;
+			case 5:
+				if (!location.has_metrics)
+					return false;
+				out = location.metrics;
+				break;
+			case 6: byte_aligned = true; metrics_size = BIG_METRICS_SIZE; read_big_metrics(r, out); break;
+			case 7: metrics_size = BIG_METRICS_SIZE; read_big_metrics(r, out); break;
+			default:
+				// 8 and 9 are built from other glyphs' bitmaps, those are rasterized instead
+				return false;
+			}
+			if (location.length < metrics_size)
+				return false;
+
+			const uint32_t depth = s.bit_depth;
+			const uint64_t row_bits = byte_aligned ? (((uint64_t)out.width * depth + 7) / 8) * 8 : (uint64_t)out.width * depth;
+			const uint64_t image_bytes = (row_bits * out.height + 7) / 8;
+			if (metrics_size + image_bytes > location.length)
+				return false;
+
+			const uint8_t* bits = reinterpret_cast<const uint8_t*>(r.get_bytes(location.offset + metrics_size, static_cast<size_t>(image_bytes)));
+			const uint32_t max_value = (1u << depth) - 1;
+			out.coverage.resize((size_t)out.width * out.height);
+			for (uint32_t y = 0; y < out.height; y++)
+			{
+				uint64_t bit = row_bits * y;
+				for (uint32_t x = 0; x < out.width; x++, bit += depth)
+				{
+					// pixels are stored most significant bits first
+					uint32_t value = (bits[bit >> 3] >> (8 - depth - (bit & 7))) & max_value;
+					out.coverage[(size_t)y * out.width + x] = static_cast<uint8_t>(value * 255 / max_value);
+				}
+			}
+			return true;
+		}
+	}
+}
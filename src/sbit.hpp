@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "util.hpp"
+
+namespace tou
+{
+	namespace sbit
+	{
+		// an EBLC index subtable, the location of glyphs [first_glyph, last_glyph] is read from its header when one is drawn
+		struct index_subtable
+		{
+			uint16_t first_glyph = 0, last_glyph = 0;
+			uint64_t header = 0;	// absolute file position
+		};
+
+		// the bitmaps drawn for one pixel size
+		struct strike
+		{
+			uint8_t ppem_x = 0, ppem_y = 0;
+			uint8_t bit_depth = 1;
+			std::vector<index_subtable> subtables;	// sorted by first_glyph
+		};
+
+		// EBLC strikes and the table bounds needed to draw from them, decoded once per face
+		struct font
+		{
+			std::vector<strike> strikes;
+			uint64_t location_offset = 0, location_length = 0;	// EBLC
+			uint64_t data_offset = 0, data_length = 0;			// EBDT
+		};
+
+		// a glyph drawn from a strike, in pixels
+		struct glyph
+		{
+			uint8_t width = 0, height = 0;
+			int8_t bearing_x = 0, bearing_y = 0;	// from the origin to the left and top edges of the image
+			uint8_t advance = 0;
+			std::vector<uint8_t> coverage;			// width * height values, top row first, 0 is blank and 255 fully inked
+		};
+
+		// reads the EBLC strike list, strikes with a bit depth other than 1, 2, 4 or 8 are left out
+		bool parse_font(tou::vector_reader& reader, uint64_t location_offset, uint64_t location_length, uint64_t data_offset, uint64_t data_length,
+			uint16_t num_glyphs, font& out);
+
+		// the strike drawn at 'ppem' pixels per em, nullptr when the font has none for that size
+		const strike* find_strike(const font& f, uint16_t ppem);
+
+		// fails when the strike has no bitmap for the glyph or stores it in a format that isn't supported (composite bitmaps)
+		bool decode_glyph(const tou::vector_reader& reader, const font& f, const strike& s, uint16_t glyph_id, glyph& out);
+	}
+}
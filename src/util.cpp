@@ -3,8 +3,29 @@
 #include <fstream>
 #include <string>
 #include <filesystem>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include "util.hpp"
 
+#if defined(__AVX2__)
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define TOU_SSE2
+	#include <emmintrin.h>
+#endif
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
 namespace tou
 {
 	std::array<char, 4> split_bytes(uint32_t data)
@@ -79,13 +100,14 @@ namespace tou
 		int32_t x = (int8_t)b[0];
 		x <<= 24;
 
-		int32_t x2 = (int8_t)b[1];
+		// only the top byte carries the sign, the others must not be sign extended
+		int32_t x2 = (uint8_t)b[1];
 		x2 <<= 16;
 
-		int32_t x3 = (int8_t)b[2];
+		int32_t x3 = (uint8_t)b[2];
 		x3 <<= 8;
 
-		int32_t x4 = (int8_t)b[3];
+		int32_t x4 = (uint8_t)b[3];
 		
 		return (x | x2 | x3 | x4);
 	}
@@ -117,23 +139,177 @@ namespace tou
 	}
 
 
-	vector_reader::vector_reader()
-		:m_current_position(0)
+	void big_endian_to_native(const char* src, uint16_t* dst, size_t n)
 	{
+		size_t i = 0;
+#if defined(__AVX2__)
+		const __m256i swap16 = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+		for (; i + 16 <= n; i += 16)
+		{
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 2));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(v, swap16));
+		}
+#elif defined(TOU_SSE2)
+		for (; i + 8 <= n; i += 8)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+		}
+#endif
+		for (; i < n; i++)
+			dst[i] = join_bytes(src[i * 2], src[i * 2 + 1]);
 	}
 
-	vector_reader::vector_reader(const std::string& filepath)
-		:m_current_position(0)
+	void big_endian_to_native(const char* src, uint32_t* dst, size_t n)
 	{
-		load(filepath);
+		size_t i = 0;
+#if defined(__AVX2__)
+		const __m256i swap32 = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(v, swap32));
+		}
+#elif defined(TOU_SSE2)
+		for (; i + 4 <= n; i += 4)
+		{
+			// swap the bytes of each 16-bit half, then swap the halves
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+		}
+#endif
+		for (; i < n; i++)
+			dst[i] = join_bytes({ src[i * 4], src[i * 4 + 1], src[i * 4 + 2], src[i * 4 + 3] });
 	}
 
-	vector_reader::~vector_reader()
+
+	uint32_t big_endian_sum32(const char* src, size_t n)
 	{
+		size_t i = 0;
+		uint32_t sum = 0;
+#if defined(__AVX2__)
+		const __m256i swap32 = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+		__m256i acc = _mm256_setzero_si256();
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+			acc = _mm256_add_epi32(acc, _mm256_shuffle_epi8(v, swap32));
+		}
+		alignas(32) uint32_t lanes[8];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+		for (uint32_t lane : lanes)
+			sum += lane;
+#elif defined(TOU_SSE2)
+		// two accumulators hide the latency of the byte swap
+		__m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+		auto swap32 = [](__m128i v)
+		{
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+		};
+		for (; i + 8 <= n; i += 8)
+		{
+			acc0 = _mm_add_epi32(acc0, swap32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4))));
+			acc1 = _mm_add_epi32(acc1, swap32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 16))));
+		}
+		alignas(16) uint32_t lanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_add_epi32(acc0, acc1));
+		for (uint32_t lane : lanes)
+			sum += lane;
+#endif
+		for (; i < n; i++)
+			sum += join_bytes({ src[i * 4], src[i * 4 + 1], src[i * 4 + 2], src[i * 4 + 3] });
+		return sum;
 	}
 
-	bool vector_reader::load(const std::string& filepath)
+	void prefix_sum(int16_t* values, size_t n)
 	{
+		size_t i = 0;
+		int16_t sum = 0;
+#if defined(__AVX2__) || defined(TOU_SSE2)
+		// the 128-bit kernel is used with AVX2 too, a 256-bit scan would need lane crossing shuffles for little gain
+		__m128i carry = _mm_setzero_si128();
+		for (; i + 8 <= n; i += 8)
+		{
+			// log-step scan within the 8 lanes, then add the running total of the previous block
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+			v = _mm_add_epi16(v, _mm_slli_si128(v, 2));
+			v = _mm_add_epi16(v, _mm_slli_si128(v, 4));
+			v = _mm_add_epi16(v, _mm_slli_si128(v, 8));
+			v = _mm_add_epi16(v, carry);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), v);
+			carry = _mm_shuffle_epi32(_mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		}
+		if (i > 0)
+			sum = values[i - 1];
+#endif
+		for (; i < n; i++)
+		{
+			sum = static_cast<int16_t>(sum + values[i]);
+			values[i] = sum;
+		}
+	}
+
+	file_mapping::file_mapping()
+		:m_data(nullptr), m_size(0), m_mapped(false)
+	{
+	}
+
+	file_mapping::~file_mapping()
+	{
+		close();
+	}
+
+	bool file_mapping::open(const std::string& filepath)
+	{
+		close();
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER file_size;
+			if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+			{
+				HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (mapping != nullptr)
+				{
+					void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+					CloseHandle(mapping); // the view keeps the mapping alive
+					if (view != nullptr)
+					{
+						m_data = static_cast<const char*>(view);
+						m_size = static_cast<size_t>(file_size.QuadPart);
+						m_mapped = true;
+					}
+				}
+			}
+			CloseHandle(file);
+		}
+#else
+		int fd = ::open(filepath.c_str(), O_RDONLY);
+		if (fd != -1)
+		{
+			struct stat st;
+			if (fstat(fd, &st) == 0 && st.st_size > 0)
+			{
+				void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+				if (view != MAP_FAILED)
+				{
+					m_data = static_cast<const char*>(view);
+					m_size = static_cast<size_t>(st.st_size);
+					m_mapped = true;
+				}
+			}
+			::close(fd); // the mapping stays valid after the descriptor is closed
+		}
+#endif
+		if (m_mapped)
+			return true;
+
+		// mapping is not possible (empty file, special file, unsupported platform...), fall back to reading the file
 		std::ifstream input;
 		try
 		{
@@ -148,47 +324,374 @@ namespace tou
 			LOG(e.what());
 			return false;
 		}
-		m_bytes.reserve(std::filesystem::file_size(filepath));
-		m_bytes = std::vector<char>(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+		std::error_code error;
+		uintmax_t file_size = std::filesystem::file_size(filepath, error);
+		if (error)
+		{
+			LOG("Failed to read the size of " << filepath << ": " << error.message());
+			return false;
+		}
+		m_fallback.resize(static_cast<size_t>(file_size));
+		input.read(m_fallback.data(), static_cast<std::streamsize>(m_fallback.size()));
 		input.close();
+		m_data = m_fallback.data();
+		m_size = m_fallback.size();
+		return true;
+	}
+
+	void file_mapping::close()
+	{
+		if (m_mapped)
+		{
+#if defined(_WIN32)
+			UnmapViewOfFile(m_data);
+#else
+			munmap(const_cast<char*>(m_data), m_size);
+#endif
+		}
+		m_fallback.clear();
+		m_data = nullptr;
+		m_size = 0;
+		m_mapped = false;
+	}
+
+	bool file_mapping::fetch(uint64_t position, size_t n, byte_window& window) const
+	{
+		if (position > m_size || n > m_size - position)
+			return false;
+		window = { 0, m_size, m_data, nullptr };
 		return true;
 	}
 
+
+	paged_file::paged_file(size_t cache_bytes)
+		:m_handle(-1), m_size(0), m_cache_cap(cache_bytes), m_cached_bytes(0)
+	{
+	}
+
+	paged_file::~paged_file()
+	{
+		close();
+	}
+
+	bool paged_file::open(const std::string& filepath)
+	{
+		close();
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		LARGE_INTEGER file_size;
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size))
+		{
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+			LOG("Failed to open " << filepath);
+			return false;
+		}
+		m_handle = reinterpret_cast<intptr_t>(file);
+		m_size = static_cast<uint64_t>(file_size.QuadPart);
+#else
+		int fd = ::open(filepath.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd == -1 || fstat(fd, &st) != 0)
+		{
+			if (fd != -1)
+				::close(fd);
+			LOG("Failed to open " << filepath);
+			return false;
+		}
+		m_handle = fd;
+		m_size = static_cast<uint64_t>(st.st_size);
+#endif
+		return true;
+	}
+
+	void paged_file::close()
+	{
+		if (m_handle != -1)
+		{
+#if defined(_WIN32)
+			CloseHandle(reinterpret_cast<HANDLE>(m_handle));
+#else
+			::close(static_cast<int>(m_handle));
+#endif
+		}
+		std::unique_lock<std::shared_mutex> pinned_lock(m_pinned_mutex);
+		std::lock_guard<std::mutex> lock(m_cache_mutex);
+		m_handle = -1;
+		m_size = 0;
+		m_pinned.clear();
+		m_pages.clear();
+		m_lru.clear();
+		m_cached_bytes = 0;
+	}
+
+	size_t paged_file::cached_bytes() const
+	{
+		std::lock_guard<std::mutex> lock(m_cache_mutex);
+		return m_cached_bytes;
+	}
+
+	bool paged_file::m_read_at(uint64_t position, char* dst, size_t n) const
+	{
+		while (n > 0)
+		{
+#if defined(_WIN32)
+			OVERLAPPED overlapped{};
+			overlapped.Offset = static_cast<DWORD>(position);
+			overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+			DWORD count = 0;
+			DWORD to_read = static_cast<DWORD>(std::min<size_t>(n, 0x40000000));
+			if (!ReadFile(reinterpret_cast<HANDLE>(m_handle), dst, to_read, &count, &overlapped) || count == 0)
+				return false;
+#else
+			ssize_t count = pread(static_cast<int>(m_handle), dst, n, static_cast<off_t>(position));
+			if (count == -1 && errno == EINTR)
+				continue;
+			if (count <= 0)
+				return false;
+#endif
+			position += static_cast<uint64_t>(count);
+			dst += count;
+			n -= static_cast<size_t>(count);
+		}
+		return true;
+	}
+
+	std::shared_ptr<const std::vector<char>> paged_file::m_get_page(uint64_t page_index) const
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_cache_mutex);
+			auto it = m_pages.find(page_index);
+			if (it != m_pages.end())
+			{
+				m_lru.splice(m_lru.begin(), m_lru, it->second.lru_position);
+				return it->second.bytes;
+			}
+		}
+
+		// the page is read without holding the lock so misses on other threads don't wait behind this one's disk read
+		uint64_t begin = page_index * page_size;
+		std::shared_ptr<std::vector<char>> bytes = std::make_shared<std::vector<char>>(static_cast<size_t>(std::min<uint64_t>(page_size, m_size - begin)));
+		if (!m_read_at(begin, bytes->data(), bytes->size()))
+			return nullptr;
+
+		std::lock_guard<std::mutex> lock(m_cache_mutex);
+		auto it = m_pages.find(page_index);
+		if (it != m_pages.end())
+		{
+			// another thread read the same page meanwhile, its copy is kept
+			m_lru.splice(m_lru.begin(), m_lru, it->second.lru_position);
+			return it->second.bytes;
+		}
+
+		m_lru.push_front(page_index);
+		m_pages.insert({ page_index, { bytes, m_lru.begin() } });
+		m_cached_bytes += bytes->size();
+
+		// evict least recently used pages, the page just read always stays
+		// readers still holding an evicted page keep it alive through their window until they move on
+		while (m_cached_bytes > m_cache_cap && m_lru.size() > 1)
+		{
+			auto victim = m_pages.find(m_lru.back());
+			m_cached_bytes -= victim->second.bytes->size();
+			m_pages.erase(victim);
+			m_lru.pop_back();
+		}
+		return bytes;
+	}
+
+	bool paged_file::fetch(uint64_t position, size_t n, byte_window& window) const
+	{
+		if (position > m_size || n > m_size - position)
+			return false;
+
+		{
+			std::shared_lock<std::shared_mutex> lock(m_pinned_mutex);
+			for (const pinned_range& range : m_pinned)
+			{
+				if (position >= range.begin && position + n <= range.end)
+				{
+					window = { range.begin, range.end, range.bytes->data(), range.bytes };
+					return true;
+				}
+			}
+		}
+
+		uint64_t first_page = position / page_size;
+		uint64_t last_page = (n == 0) ? first_page : (position + n - 1) / page_size;
+		if (first_page == last_page)
+		{
+			std::shared_ptr<const std::vector<char>> page = m_get_page(first_page);
+			if (!page)
+				return false;
+			window = { first_page * page_size, first_page * page_size + page->size(), page->data(), page };
+			return true;
+		}
+
+		// the range straddles pages, read it into its own buffer instead of caching it
+		std::shared_ptr<std::vector<char>> bytes = std::make_shared<std::vector<char>>(n);
+		if (!m_read_at(position, bytes->data(), n))
+			return false;
+		window = { position, position + n, bytes->data(), bytes };
+		return true;
+	}
+
+	void paged_file::pin(uint64_t position, uint64_t n)
+	{
+		if (position >= m_size)
+			return;
+		n = std::min(n, m_size - position);
+
+		// every face loaded from a shared file pins the same tables, a range already held is not read or stored again
+		auto held = [&]
+		{
+			return std::any_of(m_pinned.begin(), m_pinned.end(), [&](const pinned_range& range) { return position >= range.begin && position + n <= range.end; });
+		};
+		{
+			std::shared_lock<std::shared_mutex> lock(m_pinned_mutex);
+			if (held())
+				return;
+		}
+
+		std::shared_ptr<std::vector<char>> bytes = std::make_shared<std::vector<char>>(static_cast<size_t>(n));
+		if (!m_read_at(position, bytes->data(), bytes->size()))
+			return;
+
+		std::unique_lock<std::shared_mutex> lock(m_pinned_mutex);
+		if (!held())
+			m_pinned.push_back({ position, position + n, bytes });
+	}
+
+
+	vector_reader::vector_reader()
+		:m_current_position(0)
+	{
+	}
+
+	vector_reader::vector_reader(const std::string& filepath)
+		:m_current_position(0)
+	{
+		load(filepath);
+	}
+
+	vector_reader::~vector_reader()
+	{
+	}
+
+	bool vector_reader::load(const std::string& filepath)
+	{
+		// nothing is copied here, the bytes are read straight from the mapping
+		std::shared_ptr<file_mapping> source = std::make_shared<file_mapping>();
+		if (!source->open(filepath))
+			return false;
+
+		m_source = source;
+		m_window = {};
+		m_current_position = 0;
+		return true;
+	}
+
+	bool vector_reader::load_partial(const std::string& filepath, size_t cache_bytes)
+	{
+		std::shared_ptr<paged_file> source = std::make_shared<paged_file>(cache_bytes);
+		if (!source->open(filepath))
+			return false;
+
+		m_source = source;
+		m_window = {};
+		m_current_position = 0;
+		return true;
+	}
+
+	void vector_reader::pin(uint64_t position, uint64_t n)
+	{
+		if (!m_source)
+			return;
+		m_source->pin(position, n);
+		m_window = {}; // the next read may now be served by the pinned range
+	}
+
+	const char* vector_reader::m_fetch(uint64_t position, size_t n)
+	{
+		if (m_source && m_source->fetch(position, n, m_window))
+			return m_window.data + (position - m_window.begin);
+
+		// the bytes that exist are followed by zeros instead of running off the end of a buffer,
+		// a corrupt length can't make the padding larger than the source itself or max_padded_read
+		m_window = {};
+		const uint64_t source_size = size();
+		if (n > max_padded_read && n > source_size)
+		{
+			LOG("A read of " << n << " bytes runs past the end of the font file");
+			return nullptr;
+		}
+
+		m_padded.assign(n, 0);
+		if (position < source_size)
+		{
+			size_t available = static_cast<size_t>(source_size - position);
+			byte_window window;
+			if (m_source->fetch(position, available, window))
+				std::memcpy(m_padded.data(), window.data + (position - window.begin), available);
+		}
+		return m_padded.data();
+	}
+
 	uint32_t vector_reader::get_uint32()
 	{
-		uint32_t x = join_bytes({ m_bytes[m_current_position], m_bytes[m_current_position + 1], m_bytes[m_current_position + 2], m_bytes[m_current_position + 3] });
+		const char* b = get_bytes(m_current_position, 4);
+		uint32_t x = join_bytes({ b[0], b[1], b[2], b[3] });
 		m_current_position += 4;
 		return x;
 	}
 
 	uint16_t vector_reader::get_uint16()
 	{
-		uint16_t x = join_bytes(m_bytes[m_current_position], m_bytes[m_current_position + 1]);
+		const char* b = get_bytes(m_current_position, 2);
+		uint16_t x = join_bytes(b[0], b[1]);
 		m_current_position += 2;
 		return x;
 	}
 
 	uint8_t vector_reader::get_uint8()
 	{
-		uint8_t x = (uint8_t)m_bytes[m_current_position];
+		uint8_t x = (uint8_t)*get_bytes(m_current_position, 1);
 		m_current_position += 1;
 		return x;
 	}
 
 	int32_t vector_reader::get_int32()
 	{
-		int32_t x = join_bytes_signed({ m_bytes[m_current_position], m_bytes[m_current_position + 1], m_bytes[m_current_position + 2], m_bytes[m_current_position + 3] });
+		const char* b = get_bytes(m_current_position, 4);
+		int32_t x = join_bytes_signed({ b[0], b[1], b[2], b[3] });
 		m_current_position += 4;
 		return x;
 	}
 
 	int16_t vector_reader::get_int16()
 	{
-		int16_t x = join_bytes_signed(m_bytes[m_current_position], m_bytes[m_current_position + 1]);
+		const char* b = get_bytes(m_current_position, 2);
+		int16_t x = join_bytes_signed(b[0], b[1]);
 		m_current_position += 2;
 		return x;
 	}
 
-}
+	void vector_reader::read_be_u16_array(uint16_t* out, size_t n)
+	{
+		if (const char* b = get_bytes(m_current_position, n * 2))
+			big_endian_to_native(b, out, n);
+		else
+			std::fill(out, out + n, 0);
+		m_current_position += n * 2;
+	}
 
+	void vector_reader::read_be_u32_array(uint32_t* out, size_t n)
+	{
+		if (const char* b = get_bytes(m_current_position, n * 4))
+			big_endian_to_native(b, out, n);
+		else
+			std::fill(out, out + n, 0);
+		m_current_position += n * 4;
+	}
 
+}
\ No newline at end of file
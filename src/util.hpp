@@ -3,6 +3,12 @@
 #include <string>
 #include <array>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
 
 #ifdef _DEBUG
 	#include <cassert>
@@ -48,28 +54,179 @@ namespace tou
 
 	uint32_t little_endian(uint32_t data);
 
+	// decode n big-endian values from src into native order (AVX2/SSE2 kernels when available, scalar otherwise)
+	void big_endian_to_native(const char* src, uint16_t* dst, size_t n);
+	void big_endian_to_native(const char* src, uint32_t* dst, size_t n);
+
+	// wrapping sum of n big-endian uint32 words, the checksum used by the sfnt table directory
+	uint32_t big_endian_sum32(const char* src, size_t n);
+
+	// in-place inclusive running sum of n values, wrapping like int16_t addition (turns glyf deltas into coordinates)
+	void prefix_sum(int16_t* values, size_t n);
+
+	// non-owning view over a contiguous array, it either points into an owned vector or into a mapped file
+	template <typename T>
+	struct array_view
+	{
+		const T* data = nullptr;
+		size_t size = 0;
+
+		array_view() = default;
+		array_view(const T* d, size_t n) : data(d), size(n) { }
+		array_view(const std::vector<T>& v) : data(v.data()), size(v.size()) { }
+
+		const T& operator[](size_t i) const { return data[i]; }
+		bool empty() const { return size == 0; }
+		const T* begin() const { return data; }
+		const T* end() const { return data + size; }
+	};
+
+	// a contiguous range of a byte_source that can be read directly
+	struct byte_window
+	{
+		uint64_t begin = 0, end = 0;				// [begin, end) in source positions
+		const char* data = nullptr;					// points at the byte for position 'begin'
+		std::shared_ptr<const void> keep_alive;		// keeps a cached page resident while it is in use
+	};
+
+	class byte_source
+	{
+	public:
+		virtual ~byte_source() = default;
+
+		virtual uint64_t size() const = 0;
+
+		// fills 'window' with a range containing [position, position + n), returns false if that range is outside the source
+		virtual bool fetch(uint64_t position, size_t n, byte_window& window) const = 0;
+
+		// hint that [position, position + n) is read often and should stay resident
+		virtual void pin(uint64_t /*position*/, uint64_t /*n*/) { }
+	};
+
+	// read-only view over the bytes of a whole file
+	// the file is memory-mapped where the platform allows it so several processes share the same page cache,
+	// otherwise it is read into an owned buffer
+	class file_mapping : public byte_source
+	{
+	public:
+		file_mapping();
+		~file_mapping();
+
+		file_mapping(const file_mapping&) = delete;
+		file_mapping& operator=(const file_mapping&) = delete;
+
+		bool open(const std::string& filepath);
+		void close();
+
+		const char* data() const { return m_data; }
+		uint64_t size() const override { return m_size; }
+		bool mapped() const { return m_mapped; }
+
+		bool fetch(uint64_t position, size_t n, byte_window& window) const override;
+
+	private:
+		const char* m_data;
+		size_t m_size;
+		bool m_mapped;
+		std::vector<char> m_fallback; // only used when the file could not be mapped
+	};
+
+	// reads a file on demand with positioned reads, resident memory is bounded by the pinned ranges plus the page cache cap
+	// pin can be called while other threads read from the file, ranges already pinned are not read or stored again
+	class paged_file : public byte_source
+	{
+	public:
+		static constexpr size_t page_size = 4096;
+
+		paged_file(size_t cache_bytes);
+		~paged_file();
+
+		paged_file(const paged_file&) = delete;
+		paged_file& operator=(const paged_file&) = delete;
+
+		bool open(const std::string& filepath);
+		void close();
+
+		uint64_t size() const override { return m_size; }
+		size_t cached_bytes() const;
+
+		bool fetch(uint64_t position, size_t n, byte_window& window) const override;
+		void pin(uint64_t position, uint64_t n) override;
+
+	private:
+		struct pinned_range
+		{
+			uint64_t begin = 0, end = 0;
+			std::shared_ptr<const std::vector<char>> bytes;
+		};
+		struct cached_page
+		{
+			std::shared_ptr<const std::vector<char>> bytes;
+			std::list<uint64_t>::iterator lru_position;
+		};
+
+		bool m_read_at(uint64_t position, char* dst, size_t n) const;
+		std::shared_ptr<const std::vector<char>> m_get_page(uint64_t page_index) const;
+
+	private:
+		intptr_t m_handle;
+		uint64_t m_size;
+		size_t m_cache_cap;
+		std::vector<pinned_range> m_pinned;
+		mutable std::shared_mutex m_pinned_mutex; // faces sharing the file pin their tables while others are reading
+		mutable std::mutex m_cache_mutex;
+		mutable std::unordered_map<uint64_t, cached_page> m_pages;
+		mutable std::list<uint64_t> m_lru; // most recently used page index first
+		mutable size_t m_cached_bytes;
+	};
+
 	class vector_reader
 	{
 	public:
+		// reads running past the end of the source are padded with zeros up to this size or the size of the source, longer ones fail
+		static constexpr size_t max_padded_read = 1 << 20;
+
 		vector_reader();
 		vector_reader(const std::string& filepath);
 		~vector_reader();
 
 		bool load(const std::string& filepath);
+		// only the pinned ranges stay resident, everything else goes through a page cache capped at cache_bytes
+		bool load_partial(const std::string& filepath, size_t cache_bytes);
+		void pin(uint64_t position, uint64_t n);
 
 		void set_position(uint64_t x) { m_current_position = x; }
 		void increment_position(uint64_t x) { m_current_position += x; }
 
 		size_t get_position() const { return m_current_position; }
-		const std::vector<char>& get_array() const { return m_bytes; }
+		uint64_t size() const { return m_source ? m_source->size() : 0; }
+		// returns n contiguous bytes at 'position' (zeros past the end of the source), valid until the next read
+		// nullptr when the read runs past the end and n is larger than both the source and max_padded_read
+		const char* get_bytes(uint64_t position, size_t n);
 		uint32_t get_uint32();
 		uint16_t get_uint16();
 		uint8_t get_uint8();
 		int32_t get_int32();
 		int16_t get_int16();
 
+		// bulk reads of n big-endian values starting at the current position, the position is advanced past them
+		void read_be_u16_array(uint16_t* out, size_t n);
+		void read_be_u32_array(uint32_t* out, size_t n);
+
+	private:
+		const char* m_fetch(uint64_t position, size_t n);
+
 	private:
 		size_t m_current_position;
-		std::vector<char> m_bytes;
+		byte_window m_window;						// the last range fetched from m_source
+		std::vector<char> m_padded;					// returned for reads running past the end of the source
+		std::shared_ptr<byte_source> m_source;		// copies of a reader share the same source
 	};
+
+	inline const char* vector_reader::get_bytes(uint64_t position, size_t n)
+	{
+		if (position >= m_window.begin && position + n <= m_window.end)
+			return m_window.data + (position - m_window.begin);
+		return m_fetch(position, n);
+	}
 }
\ No newline at end of file
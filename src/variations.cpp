@@ -0,0 +1,426 @@
+#include "variations.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace tou
+{
+	namespace variations
+	{
+		namespace
+		{
+			constexpr uint16_t SHARED_POINT_NUMBERS = 0x8000;
+			constexpr uint16_t TUPLE_COUNT_MASK = 0x0FFF;
+			constexpr uint16_t EMBEDDED_PEAK_TUPLE = 0x8000;
+			constexpr uint16_t INTERMEDIATE_REGION = 0x4000;
+			constexpr uint16_t PRIVATE_POINT_NUMBERS = 0x2000;
+			constexpr uint16_t TUPLE_INDEX_MASK = 0x0FFF;
+			constexpr uint8_t POINTS_ARE_WORDS = 0x80;
+			constexpr uint8_t DELTAS_ARE_ZERO = 0x80;
+			constexpr uint8_t DELTAS_ARE_WORDS = 0x40;
+
+			// bounds checked cursor over bytes already fetched from the font, reads past the end yield 0 and clear 'ok'
+			struct byte_cursor
+			{
+				const uint8_t* data = nullptr;
+				size_t size = 0, position = 0;
+				bool ok = true;
+
+				uint8_t u8()
+				{
+					if (position + 1 > size) { ok = false; return 0; }
+					return data[position++];
+				}
+
+				uint16_t u16()
+				{
+					if (position + 2 > size) { ok = false; return 0; }
+					uint16_t x = static_cast<uint16_t>((data[position] << 8) | data[position + 1]);
+					position += 2;
+					return x;
+				}
+
+				int16_t i16() { return static_cast<int16_t>(u16()); }
+			};
+
+			// packed point numbers, an empty result with 'all' set means every point of the glyph
+			bool read_points(byte_cursor& c, std::vector<uint16_t>& out, bool& all)
+			{
+				out.clear();
+				uint16_t count = c.u8();
+				all = count == 0;
+				if (count & 0x80)
+					count = static_cast<uint16_t>(((count & 0x7f) << 8) | c.u8());
+
+				uint16_t point = 0;
+				while (out.size() < count && c.ok)
+				{
+					uint8_t control = c.u8();
+					int run = (control & 0x7f) + 1;
+					for (int i = 0; i < run && out.size() < count; i++)
+					{
+						point = static_cast<uint16_t>(point + ((control & POINTS_ARE_WORDS) ? c.u16() : c.u8()));
+						out.push_back(point);
+					}
+				}
+				return c.ok;
+			}
+
+			bool read_deltas(byte_cursor& c, size_t count, std::vector<int16_t>& out)
+			{
+				out.clear();
+				while (out.size() < count && c.ok)
+				{
+					uint8_t control = c.u8();
+					size_t run = std::min<size_t>((control & 0x3f) + 1, count - out.size());
+					for (size_t i = 0; i < run; i++)
+					{
+						if (control & DELTAS_ARE_ZERO)
+							out.push_back(0);
+						else if (control & DELTAS_ARE_WORDS)
+							out.push_back(c.i16());
+						else
+							out.push_back(static_cast<int8_t>(c.u8()));
+					}
+				}
+				return c.ok;
+			}
+
+			// how much a tuple applies at 'coordinates', 0 if it doesn't
+			float tuple_scalar(const std::vector<int16_t>& coordinates, const int16_t* peak, const int16_t* start, const int16_t* end)
+			{
+				float scalar = 1.0f;
+				for (size_t i = 0; i < coordinates.size(); i++)
+				{
+					int32_t p = peak[i], v = coordinates[i];
+					if (p == 0 || v == p)
+						continue;
+
+					if (start)
+					{
+						// malformed regions don't restrict the tuple along that axis
+						int32_t s = start[i], e = end[i];
+						if (s > p || p > e || (s < 0 && e > 0))
+							continue;
+						if (v <= s || v >= e)
+							return 0.0f;
+						scalar *= (v < p) ? static_cast<float>(v - s) / static_cast<float>(p - s) : static_cast<float>(e - v) / static_cast<float>(e - p);
+					}
+					else
+					{
+						if (v <= std::min(0, p) || v >= std::max(0, p))
+							return 0.0f;
+						scalar *= static_cast<float>(v) / static_cast<float>(p);
+					}
+				}
+				return scalar;
+			}
+
+			// one axis of interpolate-untouched-points, for a point at x between touched points at x1 and x2
+			float interpolate(float x, float x1, float x2, float d1, float d2)
+			{
+				if (x1 == x2)
+					return (d1 == d2) ? d1 : 0.0f;
+				if (x1 > x2)
+				{
+					std::swap(x1, x2);
+					std::swap(d1, d2);
+				}
+				if (x <= x1)
+					return d1;
+				if (x >= x2)
+					return d2;
+				return d1 + (x - x1) * (d2 - d1) / (x2 - x1);
+			}
+
+			// deltas of points a sparse tuple leaves out are inferred from the touched points either side of them in the same contour
+			void interpolate_untouched(const std::vector<tou::fvec2>& points, tou::array_view<uint16_t> end_pts, const std::vector<bool>& touched, std::vector<tou::fvec2>& deltas)
+			{
+				size_t start = 0;
+				for (uint16_t end_pt : end_pts)
+				{
+					size_t end = std::min<size_t>(end_pt, touched.size() - 1);
+					if (end < start)
+						continue;
+
+					size_t first_touched = end + 1;
+					for (size_t i = start; i <= end; i++)
+						if (touched[i]) { first_touched = i; break; }
+
+					if (first_touched <= end)
+					{
+						// walk the contour once from the first touched point, filling each gap between touched neighbours
+						size_t count = end - start + 1;
+						size_t previous = first_touched;
+						for (size_t step = 1; step <= count; step++)
+						{
+							size_t i = start + (first_touched - start + step) % count;
+							if (!touched[i])
+								continue;
+							for (size_t k = start + (previous - start + 1) % count; k != i; k = start + (k - start + 1) % count)
+							{
+								deltas[k].x = interpolate(points[k].x, points[previous].x, points[i].x, deltas[previous].x, deltas[i].x);
+								deltas[k].y = interpolate(points[k].y, points[previous].y, points[i].y, deltas[previous].y, deltas[i].y);
+							}
+							previous = i;
+						}
+					}
+					start = end + 1;
+				}
+			}
+		}
+
+		bool parse_font(tou::vector_reader& reader, table_span fvar, table_span avar, table_span gvar, uint16_t num_glyphs, font& out)
+		{
+			out = {};
+			if (fvar.length < 16 || gvar.length < 20)
+				return false;
+
+			reader.set_position(fvar.offset);
+			if (reader.get_uint16() != 1)
+				return false;
+			reader.increment_position(2);
+			uint16_t axes_offset = reader.get_uint16();
+			reader.increment_position(2);
+			uint16_t axis_count = reader.get_uint16();
+			uint16_t axis_size = reader.get_uint16();
+			if (axis_count == 0 || axis_size < 20 || axes_offset + (uint64_t)axis_count * axis_size > fvar.length)
+				return false;
+
+			out.axes.resize(axis_count);
+			for (uint16_t i = 0; i < axis_count; i++)
+			{
+				reader.set_position(fvar.offset + axes_offset + (uint64_t)i * axis_size);
+				axis& a = out.axes[i];
+				a.tag = reader.get_uint32();
+				a.min_value = reader.get_int32() / 65536.0f;
+				a.default_value = reader.get_int32() / 65536.0f;
+				a.max_value = reader.get_int32() / 65536.0f;
+				if (a.min_value > a.default_value || a.default_value > a.max_value)
+					return false;
+			}
+
+			// avar is optional, a malformed one is ignored rather than failing the load
+			if (avar.length >= 8)
+			{
+				reader.set_position(avar.offset);
+				uint16_t major = reader.get_uint16();
+				reader.increment_position(4);
+				if (major == 1 && reader.get_uint16() == axis_count)
+				{
+					out.segment_maps.resize(axis_count);
+					for (auto& map : out.segment_maps)
+					{
+						uint16_t count = reader.get_uint16();
+						if (reader.get_position() + count * 4ull > avar.offset + avar.length)
+						{
+							out.segment_maps.clear();
+							break;
+						}
+						map.resize(count);
+						for (auto& pair : map)
+						{
+							pair.first = reader.get_int16();
+							pair.second = reader.get_int16();
+						}
+					}
+				}
+			}
+
+			reader.set_position(gvar.offset);
+			if (reader.get_uint16() != 1)
+				return false;
+			reader.increment_position(2);
+			if (reader.get_uint16() != axis_count)
+				return false;
+			uint16_t shared_tuple_count = reader.get_uint16();
+			uint32_t shared_tuples_offset = reader.get_uint32();
+			uint16_t glyph_count = reader.get_uint16();
+			uint16_t flags = reader.get_uint16();
+			uint32_t data_offset = reader.get_uint32();
+			if (glyph_count != num_glyphs)
+				return false;
+
+			bool long_offsets = (flags & 1) != 0;
+			uint64_t offsets_size = ((uint64_t)glyph_count + 1) * (long_offsets ? 4 : 2);
+			if (20 + offsets_size > gvar.length || shared_tuples_offset + (uint64_t)shared_tuple_count * axis_count * 2 > gvar.length)
+				return false;
+
+			out.glyph_data.resize((size_t)glyph_count + 1);
+			if (long_offsets)
+				reader.read_be_u32_array(out.glyph_data.data(), out.glyph_data.size());
+			else
+			{
+				std::vector<uint16_t> halves(out.glyph_data.size());
+				reader.read_be_u16_array(halves.data(), halves.size());
+				for (size_t i = 0; i < halves.size(); i++)
+					out.glyph_data[i] = (uint32_t)halves[i] * 2;
+			}
+			uint32_t previous = 0;
+			for (size_t i = 0; i < out.glyph_data.size(); i++)
+			{
+				uint64_t position = gvar.offset + (uint64_t)data_offset + out.glyph_data[i];
+				if (out.glyph_data[i] < previous || position > gvar.offset + gvar.length)
+					return false;
+				previous = out.glyph_data[i];
+				out.glyph_data[i] = static_cast<uint32_t>(position);
+			}
+
+			out.shared_tuples.resize((size_t)shared_tuple_count * axis_count);
+			reader.set_position(gvar.offset + shared_tuples_offset);
+			reader.read_be_u16_array(reinterpret_cast<uint16_t*>(out.shared_tuples.data()), out.shared_tuples.size());
+			return true;
+		}
+
+		std::vector<int16_t> normalize(const font& f, const std::vector<float>& user_coordinates)
+		{
+			auto to_f2dot14 = [](float v) { return static_cast<int16_t>(std::floor(std::clamp(v, -1.0f, 1.0f) * 16384.0f + 0.5f)); };
+
+			std::vector<int16_t> coordinates(f.axes.size(), 0);
+			for (size_t i = 0; i < f.axes.size() && i < user_coordinates.size(); i++)
+			{
+				const axis& a = f.axes[i];
+				float v = std::clamp(user_coordinates[i], a.min_value, a.max_value);
+				float n = 0.0f;
+				if (v < a.default_value)
+					n = (v - a.default_value) / (a.default_value - a.min_value);
+				else if (v > a.default_value)
+					n = (v - a.default_value) / (a.max_value - a.default_value);
+				coordinates[i] = to_f2dot14(n);
+
+				// avar remaps the default normalization piecewise linearly
+				if (i < f.segment_maps.size() && f.segment_maps[i].size() >= 2)
+				{
+					const auto& map = f.segment_maps[i];
+					int16_t c = coordinates[i];
+					size_t k = 1;
+					while (k < map.size() - 1 && map[k].first < c)
+						k++;
+					const auto& lo = map[k - 1];
+					const auto& hi = map[k];
+					if (c <= lo.first)
+						coordinates[i] = lo.second;
+					else if (c >= hi.first)
+						coordinates[i] = hi.second;
+					else
+						coordinates[i] = to_f2dot14((lo.second + (c - lo.first) * static_cast<float>(hi.second - lo.second) / (hi.first - lo.first)) / 16384.0f);
+				}
+			}
+			return coordinates;
+		}
+
+		bool glyph_deltas(const tou::vector_reader& reader, const font& f, uint16_t glyph_id, const std::vector<int16_t>& coordinates,
+			const std::vector<tou::fvec2>& points, tou::array_view<uint16_t> end_pts, std::vector<tou::fvec2>& deltas)
+		{
+			deltas.assign(points.size(), {});
+			if ((size_t)glyph_id + 1 >= f.glyph_data.size() || coordinates.size() != f.axes.size())
+				return false;
+
+			uint32_t begin = f.glyph_data[glyph_id], end = f.glyph_data[(size_t)glyph_id + 1];
+			if (begin == end)
+				return true;
+
+			// the whole variation data of the glyph is fetched once, later reads go through the cursors
+			tou::vector_reader r = reader;
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(r.get_bytes(begin, end - begin));
+			if (!bytes)
+				return false;
+			byte_cursor header{ bytes, end - begin };
+			uint16_t tuple_count = header.u16();
+			uint16_t data_offset = header.u16();
+			byte_cursor data{ header.data, header.size, data_offset };
+
+			std::vector<uint16_t> shared_points, private_points;
+			bool shared_all = false;
+			if ((tuple_count & SHARED_POINT_NUMBERS) && !read_points(data, shared_points, shared_all))
+				return false;
+
+			const size_t axis_count = f.axes.size();
+			std::vector<int16_t> x_deltas, y_deltas, embedded(axis_count * 3);
+			std::vector<tou::fvec2> tuple_deltas;
+			std::vector<bool> touched;
+			for (uint16_t t = 0; t < (tuple_count & TUPLE_COUNT_MASK); t++)
+			{
+				uint16_t data_size = header.u16();
+				uint16_t tuple_index = header.u16();
+
+				const int16_t* peak = nullptr;
+				if (tuple_index & EMBEDDED_PEAK_TUPLE)
+				{
+					for (size_t i = 0; i < axis_count; i++)
+						embedded[i] = header.i16();
+					peak = embedded.data();
+				}
+				else
+				{
+					size_t shared = (size_t)(tuple_index & TUPLE_INDEX_MASK) * axis_count;
+					if (shared + axis_count > f.shared_tuples.size())
+						return false;
+					peak = f.shared_tuples.data() + shared;
+				}
+
+				const int16_t* start = nullptr;
+				const int16_t* stop = nullptr;
+				if (tuple_index & INTERMEDIATE_REGION)
+				{
+					for (size_t i = 0; i < axis_count * 2; i++)
+						embedded[axis_count + i] = header.i16();
+					start = embedded.data() + axis_count;
+					stop = start + axis_count;
+				}
+				if (!header.ok)
+					return false;
+
+				size_t tuple_begin = data.position;
+				data.position += data_size;
+				float scalar = tuple_scalar(coordinates, peak, start, stop);
+				if (scalar == 0.0f)
+					continue;
+
+				byte_cursor tuple{ data.data, std::min(data.size, tuple_begin + data_size), tuple_begin };
+				const std::vector<uint16_t>* point_numbers = &shared_points;
+				bool all = shared_all;
+				if (tuple_index & PRIVATE_POINT_NUMBERS)
+				{
+					if (!read_points(tuple, private_points, all))
+						return false;
+					point_numbers = &private_points;
+				}
+				if (!(tuple_index & PRIVATE_POINT_NUMBERS) && !(tuple_count & SHARED_POINT_NUMBERS))
+					return false;
+
+				size_t count = all ? points.size() : point_numbers->size();
+				if (!read_deltas(tuple, count, x_deltas) || !read_deltas(tuple, count, y_deltas))
+					return false;
+
+				if (all)
+				{
+					for (size_t i = 0; i < count; i++)
+					{
+						deltas[i].x += x_deltas[i] * scalar;
+						deltas[i].y += y_deltas[i] * scalar;
+					}
+					continue;
+				}
+
+				tuple_deltas.assign(points.size(), {});
+				touched.assign(points.size(), false);
+				for (size_t i = 0; i < count; i++)
+				{
+					uint16_t p = (*point_numbers)[i];
+					if (p >= points.size())
+						continue;
+					tuple_deltas[p].x += x_deltas[i];
+					tuple_deltas[p].y += y_deltas[i];
+					touched[p] = true;
+				}
+				interpolate_untouched(points, end_pts, touched, tuple_deltas);
+				for (size_t i = 0; i < points.size(); i++)
+				{
+					deltas[i].x += tuple_deltas[i].x * scalar;
+					deltas[i].y += tuple_deltas[i].y * scalar;
+				}
+			}
+			return true;
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "util.hpp"
+
+namespace tou
+{
+	namespace variations
+	{
+		// an fvar axis, values are in user units (e.g. 100-900 for 'wght')
+		struct axis
+		{
+			uint32_t tag = 0;
+			float min_value = 0.0f, default_value = 0.0f, max_value = 0.0f;
+		};
+
+		// position of a table in the font file, a missing table has length 0
+		struct table_span
+		{
+			uint64_t offset = 0, length = 0;
+		};
+
+		// fvar axes, avar segment maps and the gvar offsets needed to instance glyphs, decoded once per face
+		struct font
+		{
+			std::vector<axis> axes;
+			std::vector<std::vector<std::pair<int16_t, int16_t>>> segment_maps;	// avar, one map per axis or empty
+			std::vector<int16_t> shared_tuples;									// axes.size() F2DOT14 coordinates per tuple
+			std::vector<uint32_t> glyph_data;									// absolute position of each glyph's variation data, num_glyphs + 1 entries
+		};
+
+		bool parse_font(tou::vector_reader& reader, table_span fvar, table_span avar, table_span gvar, uint16_t num_glyphs, font& out);
+
+		// user coordinates (one per axis, clamped to its range) to normalized F2DOT14 coordinates, avar applied
+		std::vector<int16_t> normalize(const font& f, const std::vector<float>& user_coordinates);
+
+		// sums the deltas of every tuple of glyph_id that applies at 'coordinates'
+		// 'points' holds the glyph's points followed by its 4 phantom points, 'end_pts' the last point of each contour
+		// composite glyphs pass their component offsets as points and no contours, since those are never interpolated
+		bool glyph_deltas(const tou::vector_reader& reader, const font& f, uint16_t glyph_id, const std::vector<int16_t>& coordinates,
+			const std::vector<tou::fvec2>& points, tou::array_view<uint16_t> end_pts, std::vector<tou::fvec2>& deltas);
+	}
+}
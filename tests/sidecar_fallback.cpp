@@ -0,0 +1,129 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "test.hpp"
+
+// a sidecar whose key still matches the font but whose contents are stale or corrupt must be ignored, the face is then
+// parsed from the font file as if there was no sidecar and the sidecar is written again
+
+// field offsets in the sidecar header (see sidecar_header in font_face.cpp)
+constexpr size_t PATH_LENGTH = 24, NUM_TABLES = 28, NUM_LOCA = 32, NUM_HMETRICS = 36, NUM_GLYPHS = 40, NUM_HORI_METRICS = 42, INDEX_TO_LOC_FORMAT = 46;
+constexpr size_t HEADER_SIZE = 64;
+
+static std::vector<char> read_file(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string& path, const std::vector<char>& bytes)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+template <typename T>
+static T get(const std::vector<char>& bytes, size_t offset)
+{
+	T value;
+	std::memcpy(&value, bytes.data() + offset, sizeof(T));
+	return value;
+}
+
+template <typename T>
+static void set(std::vector<char>& bytes, size_t offset, T value)
+{
+	std::memcpy(bytes.data() + offset, &value, sizeof(T));
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::printf("usage: %s font.ttf scratch_directory\n", argv[0]);
+		return 1;
+	}
+	const std::string font = argv[1];
+	tou::font_load_options options;
+	options.cache_directory = test::scratch_directory(argv[2]);
+
+	uint64_t reference = 0;
+	{
+		tou::font_face face(font);
+		CHECK(face.ok());
+		reference = test::digest(face);
+	}
+
+	// the first load parses the font and writes the sidecar, the second one is served from it
+	std::string sidecar_path;
+	{
+		tou::font_face face(font, options);
+		CHECK(face.ok());
+	}
+	for (const auto& entry : std::filesystem::directory_iterator(options.cache_directory))
+		if (entry.path().extension() == ".ffcache")
+			sidecar_path = entry.path().string();
+	CHECK(!sidecar_path.empty());
+	if (sidecar_path.empty())
+		return 1;
+	const std::vector<char> good = read_file(sidecar_path);
+	CHECK(good.size() > HEADER_SIZE);
+	{
+		tou::font_face face(font, options);
+		CHECK(face.ok() && test::digest(face) == reference);
+	}
+
+	// the table records follow the header and the font's path, each 8 byte aligned
+	size_t records = HEADER_SIZE + ((get<uint32_t>(good, PATH_LENGTH) + 7) & ~size_t(7));
+	uint32_t num_tables = get<uint32_t>(good, NUM_TABLES);
+	size_t glyf_record = 0;
+	for (uint32_t i = 0; i < num_tables; i++)
+		if (get<uint32_t>(good, records + i * 16) == 0x676C7966) // 'glyf'
+			glyf_record = records + i * 16;
+	CHECK(glyf_record != 0);
+	if (glyf_record == 0)
+		return 1;
+
+	struct corruption
+	{
+		const char* name;
+		void (*apply)(std::vector<char>& bytes, size_t records, size_t glyf_record);
+	};
+	const corruption corruptions[] =
+	{
+		{ "more glyphs than loca entries", [](std::vector<char>& b, size_t, size_t) { set<uint16_t>(b, NUM_GLYPHS, get<uint16_t>(b, NUM_GLYPHS) + 100); } },
+		{ "fewer loca entries than glyphs", [](std::vector<char>& b, size_t, size_t) { set<uint32_t>(b, NUM_LOCA, get<uint32_t>(b, NUM_LOCA) / 2); } },
+		{ "hhea and hmtx counts disagree", [](std::vector<char>& b, size_t, size_t) { set<uint16_t>(b, NUM_HORI_METRICS, get<uint16_t>(b, NUM_HORI_METRICS) + 1); } },
+		{ "no horizontal metrics", [](std::vector<char>& b, size_t, size_t) { set<uint16_t>(b, NUM_HORI_METRICS, 0); set<uint32_t>(b, NUM_HMETRICS, 0); } },
+		{ "unknown loca format", [](std::vector<char>& b, size_t, size_t) { set<int16_t>(b, INDEX_TO_LOC_FORMAT, 2); } },
+		{ "missing glyf record", [](std::vector<char>& b, size_t, size_t glyf) { set<uint32_t>(b, glyf, 0x676C7967); } }, // 'glyg' keeps the order
+		{ "glyf past the end of the font", [](std::vector<char>& b, size_t, size_t glyf) { set<uint32_t>(b, glyf + 8, 0xFFFFFF00); } },
+		{ "records out of order", [](std::vector<char>& b, size_t records, size_t)
+			{
+				std::vector<char> first(b.begin() + records, b.begin() + records + 16);
+				std::copy(b.begin() + records + 16, b.begin() + records + 32, b.begin() + records);
+				std::copy(first.begin(), first.end(), b.begin() + records + 16);
+			} },
+	};
+
+	for (const corruption& c : corruptions)
+	{
+		std::vector<char> bytes = good;
+		c.apply(bytes, records, glyf_record);
+		write_file(sidecar_path, bytes);
+		{
+			tou::font_face face(font, options);
+			if (!face.ok() || test::digest(face) != reference)
+			{
+				std::printf("%s: the face did not fall back to parsing the font\n", c.name);
+				test::failures++;
+			}
+		}
+		// the full parse replaces the rejected sidecar with a good one
+		CHECK(read_file(sidecar_path) == good);
+	}
+
+	return test::failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#include "font_face.hpp"
+
+namespace test
+{
+	inline int failures = 0;
+
+	// the outline, metrics and coverage of the printable ASCII glyphs, faces giving the same value decode the same outlines
+	inline uint64_t digest(tou::font_face& face)
+	{
+		uint64_t hash = 1469598103934665603ull;
+		auto mix = [&](uint64_t value) { hash = (hash ^ value) * 1099511628211ull; };
+		for (uint32_t codepoint = 0x20; codepoint < 0x7F; codepoint++)
+		{
+			mix(face.has_glyph(codepoint));
+			const tou::font_face::truetype_glyph& glyph = face.get_glyph(codepoint);
+			mix(glyph.id);
+			mix(glyph.advance_width);
+			mix(static_cast<uint16_t>(glyph.left_side_bearing));
+			for (size_t i = 0; i < glyph.outline.num_points(); i++)
+			{
+				mix(static_cast<uint16_t>(glyph.outline.x()[i]));
+				mix(static_cast<uint16_t>(glyph.outline.y()[i]));
+				mix(glyph.outline.flags()[i]);
+			}
+			for (size_t i = 0; i < glyph.outline.num_contours(); i++)
+				mix(glyph.outline.end_points()[i]);
+		}
+		return hash;
+	}
+
+	// empties the scratch directory the test was given
+	inline std::string scratch_directory(const char* path)
+	{
+		std::error_code ec;
+		std::filesystem::remove_all(path, ec);
+		std::filesystem::create_directories(path, ec);
+		return path;
+	}
+}
+
+#define CHECK(condition) \
+	do { if (!(condition)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); test::failures++; } } while (0)